@@ -0,0 +1,34 @@
+#!/bin/bash
+# Builds the kernel microbenchmarks against the MPI engine and runs them on positions of saj instances.
+# Results are appended to RESULTS (JSON lines) labelled with the git revision, so versions of the kernels
+# can be compared.
+# usage: bench-kernels.sh [label]
+# EXTRA_FLAGS are added to the compiler flags, e.g. EXTRA_FLAGS=-DMAILBOX_BOARD bench-kernels.sh mailbox
+# measures the kernels on boards with sentinel border against the default bounds-checked board
+
+CPP_PROGRAM_TEMPLATE="$(dirname $(realpath $0))/../mpi/main.template.cpp"
+CPP_COMPILE="mpicxx"
+CPP_FLAGS="--std=c++11 -lm -O3 -funroll-loops -fopenmp ${EXTRA_FLAGS}"
+DATA_PATH=${DATA_PATH:-"/home/saframa6/ni-pdp-semestralka/data"}
+RESULTS=${RESULTS:-"$(dirname $(realpath $0))/results/kernels.json"}
+
+INSTANCES=(7 10 12) # saj instance id
+LABEL=${1:-$(git -C $(dirname $(realpath $0)) describe --always --dirty)}
+
+BUILD_DIR=$(mktemp -d)
+trap "rm -rf ${BUILD_DIR}" EXIT
+
+# kernels do not depend on the number of threads
+sed "s/{PROCNUM}/1/g" ${CPP_PROGRAM_TEMPLATE} > ${BUILD_DIR}/engine.cpp
+echo -e "COMPILE: ${CPP_COMPILE} ${CPP_FLAGS} kernels.cpp"
+${CPP_COMPILE} ${CPP_FLAGS} -DENGINE_SOURCE="\"${BUILD_DIR}/engine.cpp\"" \
+	$(dirname $(realpath $0))/kernels.cpp -o ${BUILD_DIR}/kernels.out || exit 1
+
+mkdir -p $(dirname ${RESULTS})
+FILES=()
+for INSTANCE in ${INSTANCES[*]}
+do
+	FILES+=("${DATA_PATH}/saj${INSTANCE}.txt")
+done
+${BUILD_DIR}/kernels.out --label=${LABEL} --report=${RESULTS} ${FILES[*]}
+echo "Výsledky: ${RESULTS} (${LABEL})"
@@ -0,0 +1,229 @@
+// Microbenchmarks of the search kernels of the MPI engine, built and run by bench-kernels.sh.
+// The engine is included as a whole, its main is renamed so the benchmark can have its own.
+#define main engineMain
+#include ENGINE_SOURCE
+#undef main
+
+#include <random>
+#include <new>
+
+#define POSITION_CNT 1000 // positions sampled from each instance
+#define POSITION_SEED 1 // positions are the same in every run
+#define MIN_MEASURE_TIME 0.2 // each kernel is repeated over all positions for at least this long [s]
+
+// heap allocations so far, counted by the replaced global operator new
+static long allocations = 0;
+
+void *operator new(size_t size) {
+    allocations++;
+    void *p = malloc(size ? size : 1);
+    if (!p) throw bad_alloc();
+    return p;
+}
+
+void operator delete(void *p) noexcept {
+    free(p);
+}
+
+void operator delete(void *p, size_t) noexcept {
+    free(p);
+}
+
+// moves of the side to play copied out of their move list, whose type differs for horse and bishop
+vector<NextPossibleMoves::NextMove> nextMoves(const Instance &ins) {
+    if (ins.play == HORSE) {
+        auto moves = NextPossibleMoves::for_horse(ins.board);
+        return vector<NextPossibleMoves::NextMove>(moves.begin(), moves.end());
+    }
+    auto moves = NextPossibleMoves::for_bishop(ins.board);
+    return vector<NextPossibleMoves::NextMove>(moves.begin(), moves.end());
+}
+
+// keeps results of the kernels alive, so the compiler cannot drop the measured calls
+static volatile long sink = 0;
+
+// makes the compiler assume all bytes of value are read, so producing a whole object cannot be cut down to the
+// fields used afterwards (a trivially copyable board would otherwise not be copied at all)
+template<class T>
+void escape(const T &value) {
+    asm volatile("" : : "r"(&value) : "memory");
+}
+
+/**
+ * Positions reached by random play from the initial board, bishop moves first.
+ * Every position of a playout is taken, so positions of all depths are measured.
+ */
+vector<Instance> samplePositions(const ChessBoard &initial, int count, unsigned seed) {
+    mt19937 rng(seed);
+    vector<Instance> positions;
+    while (int(positions.size()) < count) {
+        Instance ins(initial, 0, BISHOP, numeric_limits<int>::max());
+        while (int(positions.size()) < count && ins.board.getPawnCnt() > 0 && ins.depth < ins.board.getMaxDepth()) {
+            positions.push_back(ins);
+            auto moves = nextMoves(ins);
+            if (moves.empty()) break;
+            const auto &m = moves[rng() % moves.size()];
+            if (ins.play == HORSE) ins.board.moveHorse(m.row, m.col);
+            else ins.board.moveBishop(m.row, m.col);
+            ins.depth++;
+            ins.play = ins.play == HORSE ? BISHOP : HORSE;
+        }
+    }
+    return positions;
+}
+
+struct KernelResult {
+    string kernel;
+    long ops;
+    double nsPerOp;
+    double allocationsPerOp;
+};
+
+/**
+ * Runs pass repeatedly until MIN_MEASURE_TIME has elapsed, pass returns number of operations it has done.
+ * prepare is called before each pass outside of the measured time and its allocations are not counted.
+ */
+template<class Prepare, class Pass>
+KernelResult measure(const string &kernel, Prepare prepare, Pass pass) {
+    prepare();
+    pass(); // warm-up
+    long ops = 0;
+    long passAllocations = 0;
+    double measured = 0;
+    while (measured < MIN_MEASURE_TIME) {
+        prepare();
+        long before = allocations;
+        auto start = chrono::steady_clock::now();
+        ops += pass();
+        measured += chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        passAllocations += allocations - before;
+    }
+    return KernelResult{kernel, ops, 1e9 * measured / ops, double(passAllocations) / ops};
+}
+
+template<class Pass>
+KernelResult measure(const string &kernel, Pass pass) {
+    return measure(kernel, [] {}, pass);
+}
+
+vector<KernelResult> measureKernels(vector<Instance> &positions) {
+    vector<KernelResult> results;
+    // target squares of the next move of each position, input of EvalPosition and move kernels
+    vector<vector<NextPossibleMoves::NextMove>> moves;
+    for (const auto &ins : positions) moves.push_back(nextMoves(ins));
+
+    results.push_back(measure("NextPossibleMoves::for_horse", [&] {
+        for (const auto &ins : positions) sink += NextPossibleMoves::for_horse(ins.board).size();
+        return long(positions.size());
+    }));
+    results.push_back(measure("NextPossibleMoves::for_bishop", [&] {
+        for (const auto &ins : positions) sink += NextPossibleMoves::for_bishop(ins.board).size();
+        return long(positions.size());
+    }));
+    results.push_back(measure("EvalPosition::for_horse", [&] {
+        long ops = 0;
+        for (size_t i = 0; i < positions.size(); i++) {
+            for (const auto &m : moves[i]) sink += EvalPosition::for_horse(positions[i].board, m.row, m.col);
+            ops += moves[i].size();
+        }
+        return ops;
+    }));
+    results.push_back(measure("EvalPosition::for_bishop", [&] {
+        long ops = 0;
+        for (size_t i = 0; i < positions.size(); i++) {
+            for (const auto &m : moves[i]) sink += EvalPosition::for_bishop(positions[i].board, m.row, m.col);
+            ops += moves[i].size();
+        }
+        return ops;
+    }));
+    results.push_back(measure("ChessBoard copy", [&] {
+        for (const auto &ins : positions) {
+            ChessBoard cpy(ins.board);
+            escape(cpy);
+        }
+        return long(positions.size());
+    }));
+
+    // boards are assigned to and moved on in place, they are reset from positions before each pass
+    vector<ChessBoard> boards;
+    for (const auto &ins : positions) boards.push_back(ins.board);
+    auto reset = [&] {
+        for (size_t i = 0; i < positions.size(); i++) boards[i] = positions[i].board;
+    };
+    results.push_back(measure("ChessBoard assign", [&] {
+        for (size_t i = 0; i < positions.size(); i++) boards[(i + 1) % boards.size()] = positions[i].board;
+        return long(positions.size());
+    }));
+    results.push_back(measure("ChessBoard::movePiece", reset, [&] {
+        long ops = 0;
+        for (size_t i = 0; i < positions.size(); i++) {
+            if (moves[i].empty()) continue;
+            const auto &m = moves[i][0];
+            if (positions[i].play == HORSE) boards[i].moveHorse(m.row, m.col);
+            else boards[i].moveBishop(m.row, m.col);
+            sink += boards[i].getPawnCnt();
+            ops++;
+        }
+        return ops;
+    }));
+
+    int bufLen = 0;
+    for (const auto &ins : positions) bufLen = max(bufLen, ins.maxSerializedSize());
+    vector<vector<char>> buffers(positions.size(), vector<char>(bufLen));
+    vector<int> written(positions.size());
+    results.push_back(measure("Instance::serializeToBuffer", [&] {
+        for (size_t i = 0; i < positions.size(); i++) {
+            positions[i].serializeToBuffer(buffers[i].data(), bufLen, written[i]);
+        }
+        return long(positions.size());
+    }));
+    results.push_back(measure("Instance::deserializeFromBuffer", [&] {
+        for (size_t i = 0; i < positions.size(); i++) {
+            Instance ins = Instance::deserializeFromBuffer(buffers[i].data(), written[i]);
+            escape(ins);
+        }
+        return long(positions.size());
+    }));
+
+    results.push_back(measure("betterBoardExists", [&] {
+        for (const auto &ins : positions) sink += betterBoardExists(&ins, ins.board.getMaxDepth());
+        return long(positions.size());
+    }));
+    return results;
+}
+
+// usage: [--label=NAME] [--report=FILE] instance_file...
+// label names the measured version of the kernels in the report, e.g. git revision
+int main(int argc, char **argv) {
+    string label, reportPath;
+    vector<string> files;
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg.compare(0, 8, "--label=") == 0) label = arg.substr(8);
+        else if (arg.compare(0, 9, "--report=") == 0) reportPath = arg.substr(9);
+        else files.push_back(arg);
+    }
+
+    cout << "Kernel\tInstance\tns/op\tAlokace/op" << endl;
+    for (const auto &filename : files) {
+        ChessBoard initial(filename);
+        vector<Instance> positions = samplePositions(initial, POSITION_CNT, POSITION_SEED);
+        string instance = filename.substr(filename.find_last_of('/') + 1);
+        for (const auto &r : measureKernels(positions)) {
+            printf("%s\t%s\t%.1f\t%.2f\n", r.kernel.c_str(), instance.c_str(), r.nsPerOp, r.allocationsPerOp);
+            if (reportPath.empty()) continue;
+            RunReport report;
+            report.addText("benchmark", "kernels");
+            report.addText("label", label);
+            report.addText("kernel", r.kernel);
+            report.addText("instance", filename);
+            report.addText("instance_hash", initial.hash());
+            report.addCount("positions", positions.size());
+            report.addCount("ops", r.ops);
+            report.addTime("ns_per_op", r.nsPerOp);
+            report.addTime("allocations_per_op", r.allocationsPerOp);
+            report.append(reportPath);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,28 @@
+#!/bin/bash
+# Performance regression gate, runs a reduced benchmark set and compares it with the stored baseline.
+# Fails (exit code 1) if nodes per second or search/wall time regress by more than TOLERANCE, see tools/perfgate.py.
+# usage: perf-gate.sh [record|check]
+#   record  measures the baseline on this machine, do it before the optimisation
+#   check   (default) compares the current tree with it
+# BASELINE=results/baseline-sge.json holds the runs of the tester scripts on the cluster (perfgate.py import),
+# node throughput of the OpenMP engines measured there is comparable only when run on the same cluster.
+
+TOOLS="$(dirname $(realpath $0))/../tools"
+DATA_PATH=${DATA_PATH:-"/home/saframa6/ni-pdp-semestralka/data"}
+BASELINE=${BASELINE:-"$(dirname $(realpath $0))/results/baseline.json"}
+TOLERANCE=${TOLERANCE:-0.1}
+MPIRUN=${MPIRUN:-"mpirun"}
+
+ENGINES="openmp-task,openmp-data,mpi-flat"
+INSTANCES="7" # saj instance id
+PROCNUMS="1,4" # number of openmp cores
+NODENUMS="3" # number of MPI processes
+SWEEP_OPTIONS=(--engines ${ENGINES} --instances ${INSTANCES} --threads ${PROCNUMS} --ranks ${NODENUMS}
+	--warmup 1 --repeats 3 --data ${DATA_PATH} --mpirun "${MPIRUN}")
+
+mkdir -p $(dirname ${BASELINE})
+case ${1:-check} in
+	record) python3 ${TOOLS}/perfgate.py record ${BASELINE} "${SWEEP_OPTIONS[@]}" ;;
+	check) python3 ${TOOLS}/perfgate.py check ${BASELINE} --tolerance ${TOLERANCE} "${SWEEP_OPTIONS[@]}" ;;
+	*) echo "usage: $0 [record|check]"; exit 2 ;;
+esac
@@ -0,0 +1,2093 @@
+#include <iostream>
+#include <cstring>
+#include <fstream>
+#include <vector>
+#include <limits>
+#include <chrono>
+#include <algorithm>
+#include <cstdint>
+#include <map>
+#include <cstdio>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <type_traits>
+#include <queue>
+#include <unordered_map>
+#include <random>
+#include <sstream>
+#include <omp.h>
+#include "mpi.h"
+#ifdef PERF_COUNTERS
+#include <cerrno>
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#endif
+
+// chess pieces
+#define HORSE  'J'
+#define BISHOP 'S'
+#define PAWN 'P'
+#define EMPTY '-'
+
+#ifndef MAX_ROW_LEN
+#define MAX_ROW_LEN 16 // longest side of a board, bounds the grid of ChessBoard and the move lists
+#endif
+#ifndef MAX_DEPTH
+#define MAX_DEPTH 64 // largest max depth of an instance, bounds the move log of ChessBoard
+#endif
+#define HORSE_MOVE_CAPACITY 8
+#define BISHOP_MOVE_CAPACITY (2 * (MAX_ROW_LEN - 1)) // both diagonals through the square
+#define MAX_MOVE_COST 3 // of EvalPosition
+#ifdef MAILBOX_BOARD
+#define BOARD_BORDER 2 // sentinel rows and columns around the grid, a horse jump from the board stays in them
+#else
+#define BOARD_BORDER 0
+#endif
+#define GRID_CAPACITY ((MAX_ROW_LEN + 2 * BOARD_BORDER) * (MAX_ROW_LEN + 2 * BOARD_BORDER))
+
+// returns fn<N>(args...) with N the side of board g, kernels of the sizes we run are specialised at compile time
+// (constant index arithmetic and bounds), other sizes use fn<0>, which reads the side from the board
+#define DISPATCH_ROW_LEN(g, fn, ...) \
+    switch ((g).getRowLen()) { \
+        case 5: return fn<5>(__VA_ARGS__); \
+        case 6: return fn<6>(__VA_ARGS__); \
+        case 7: return fn<7>(__VA_ARGS__); \
+        case 8: return fn<8>(__VA_ARGS__); \
+        case 9: return fn<9>(__VA_ARGS__); \
+        case 10: return fn<10>(__VA_ARGS__); \
+        case 11: return fn<11>(__VA_ARGS__); \
+        case 12: return fn<12>(__VA_ARGS__); \
+        case 13: return fn<13>(__VA_ARGS__); \
+        case 14: return fn<14>(__VA_ARGS__); \
+        case 15: return fn<15>(__VA_ARGS__); \
+        case 16: return fn<16>(__VA_ARGS__); \
+        default: return fn<0>(__VA_ARGS__); \
+    }
+
+/**
+ * MPI message TAGs
+ */
+enum MessageTag {
+    WORK = 1, // batch of states owned by the receiver
+    UPDATE = 3, // best board, sent to master at the end
+    INCUMBENT = 4 // improved bestPathLen, sent to all other ranks as soon as it is found
+};
+
+
+// relative mapping for all possible horse movements
+// [ROW, COL]
+const int HORSE_CAND[8][2] = {
+        {-2, -1},
+        {-2, 1},
+
+        {-1, 2},
+        {1,  2},
+
+        {2,  1},
+        {2,  -1},
+
+        {1,  -2},
+        {-1, -2}
+};
+
+// states for one rank are sent once there is this many of them
+#define HDA_BATCH_SIZE 64
+
+// seed of Zobrist keys, must be the same on all ranks
+#define ZOBRIST_SEED 0x5eed
+
+using namespace std;
+
+#define TRACE_CAPACITY 65536 // events kept per thread, older ones are overwritten
+
+/**
+ * Opt-in timeline of the run (--trace=FILE) in Chrome trace JSON format, open it in ui.perfetto.dev or chrome://tracing.
+ * Each thread records events to its own ring buffer without locking, only the last TRACE_CAPACITY events of each
+ * thread are kept. Until the tracer is started, recording an event costs a single branch.
+ */
+class Tracer {
+public:
+    // span if dur >= 0, instant event otherwise; names are string literals, unused arguments have no name
+    struct Event {
+        const char *name;
+        int64_t start; // [ns] since start()
+        int64_t dur; // [ns]
+        const char *argNames[3];
+        long args[3];
+    };
+
+private:
+    struct Ring {
+        int tid;
+        vector<Event> events;
+        long written; // events[written % TRACE_CAPACITY] is overwritten next
+    };
+
+    static thread_local Ring *ring;
+    bool started = false;
+    chrono::steady_clock::time_point origin;
+    mutex mtx; // guards rings
+    vector<Ring *> rings;
+
+    void record(const Event &e) {
+        if (!ring) {
+            lock_guard<mutex> lock(mtx);
+            ring = new Ring{int(rings.size()), vector<Event>(TRACE_CAPACITY), 0};
+            rings.push_back(ring);
+        }
+        ring->events[ring->written++ % TRACE_CAPACITY] = e;
+    }
+
+public:
+    // called before any other thread records, so started is never written concurrently
+    void start() {
+        origin = chrono::steady_clock::now();
+        started = true;
+    }
+
+    bool isStarted() const {
+        return started;
+    }
+
+    int64_t now() const {
+        return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - origin).count();
+    }
+
+    void instant(const char *name, const char *arg0 = nullptr, long val0 = 0, const char *arg1 = nullptr,
+                 long val1 = 0, const char *arg2 = nullptr, long val2 = 0) {
+        if (started) record(Event{name, now(), -1, {arg0, arg1, arg2}, {val0, val1, val2}});
+    }
+
+    // span from start, as returned by now(), until now
+    void span(const char *name, int64_t start, const char *arg0 = nullptr, long val0 = 0,
+              const char *arg1 = nullptr, long val1 = 0) {
+        if (started) record(Event{name, start, now() - start, {arg0, arg1, nullptr}, {val0, val1, 0}});
+    }
+
+    // recorded events as comma separated trace event objects, pid is the process of the trace they belong to
+    string events(int pid, const string &processName) {
+        lock_guard<mutex> lock(mtx);
+        char buf[256];
+        snprintf(buf, sizeof(buf), "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"args\":{\"name\":\"%s\"}}",
+                 pid, processName.c_str());
+        string out = buf;
+        for (const Ring *r : rings) {
+            long first = max(0L, r->written - TRACE_CAPACITY);
+            if (first > 0) cerr << "Trace: vlákno " << r->tid << " přepsalo " << first << " nejstarších událostí" << endl;
+            for (long i = first; i < r->written; i++) {
+                const Event &e = r->events[i % TRACE_CAPACITY];
+                snprintf(buf, sizeof(buf), ",\n{\"name\":\"%s\",\"ph\":\"%s\",\"pid\":%d,\"tid\":%d,\"ts\":%.3f", e.name,
+                         e.dur < 0 ? "i" : "X", pid, r->tid, e.start / 1000.0);
+                out += buf;
+                if (e.dur < 0) {
+                    out += ",\"s\":\"t\"";
+                } else {
+                    snprintf(buf, sizeof(buf), ",\"dur\":%.3f", e.dur / 1000.0);
+                    out += buf;
+                }
+                out += ",\"args\":{";
+                for (int a = 0; a < 3 && e.argNames[a]; a++) {
+                    snprintf(buf, sizeof(buf), "%s\"%s\":%ld", a ? "," : "", e.argNames[a], e.args[a]);
+                    out += buf;
+                }
+                out += "}}";
+            }
+        }
+        return out;
+    }
+
+    static void write(const string &path, const string &events) {
+        ofstream os(path);
+        os << "{\"traceEvents\":[\n" << events << "\n],\"displayTimeUnit\":\"ms\"}" << endl;
+        if (!os) cerr << "Trace se nepodařilo zapsat do " << path << endl;
+    }
+};
+
+thread_local Tracer::Ring *Tracer::ring = nullptr;
+
+Tracer tracer;
+
+// records its lifetime as a span
+class TraceSpan {
+private:
+    const char *name;
+    int64_t start;
+    const char *argName;
+    long arg;
+
+public:
+    explicit TraceSpan(const char *name, const char *argName = nullptr, long arg = 0) :
+            name(name), start(tracer.isStarted() ? tracer.now() : 0), argName(argName), arg(arg) {}
+
+    ~TraceSpan() {
+        tracer.span(name, start, argName, arg);
+    }
+};
+
+// phases of the run measured by PerfCounters
+enum PerfPhase {
+    PHASE_FRONTIER = 0, // generating instances searched in parallel
+    PHASE_SEARCH = 1,
+    PHASE_SERIALIZATION = 2, // of boards and instances to and from messages
+    PHASE_COMMUNICATION = 3, // inside MPI calls
+    PHASE_CNT = 4
+};
+
+#define PERF_COUNTER_CNT 5
+
+const char *const PERF_PHASE_NAMES[PHASE_CNT] = {"frontier", "search", "serialization", "communication"};
+const char *const PERF_COUNTER_NAMES[PERF_COUNTER_CNT] = {"cycles", "instructions", "l1d_misses", "llc_misses",
+                                                          "branch_misses"};
+
+#ifdef PERF_COUNTERS
+/**
+ * Hardware performance counters of each thread split by phase of the run, built with -DPERF_COUNTERS (Linux only).
+ * Each thread opens its own group of counters by perf_event_open when it first enters a phase. Counts since the
+ * last read are added to the innermost phase the thread is in whenever it enters or leaves a phase, so nested
+ * phases are not counted twice and code outside of all phases is not counted at all.
+ * Counters the machine does not provide (e.g. in a virtual machine) stay 0.
+ */
+class PerfCounters {
+private:
+    struct ThreadCounters {
+        int leader; // fd of the group, -1 if no counter could be opened
+        vector<int> members; // counter of each value read from the group, in order of opening
+        uint64_t last[PERF_COUNTER_CNT];
+        long counts[PHASE_CNT][PERF_COUNTER_CNT];
+        vector<PerfPhase> running;
+    };
+
+    static thread_local ThreadCounters *current;
+    mutex mtx; // guards threads
+    vector<ThreadCounters *> threads;
+    atomic<bool> warned{false};
+
+    static int open(uint32_t type, uint64_t config, int groupFd) {
+        perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = type;
+        attr.config = config;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_GROUP;
+        return syscall(__NR_perf_event_open, &attr, 0, -1, groupFd, 0);
+    }
+
+    ThreadCounters *thread() {
+        if (current) return current;
+        const uint64_t events[PERF_COUNTER_CNT][2] = {
+                {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+                {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+                {PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                                     (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)},
+                {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+                {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+        };
+        current = new ThreadCounters();
+        current->leader = -1;
+        for (int c = 0; c < PERF_COUNTER_CNT; c++) {
+            int fd = open(events[c][0], events[c][1], current->leader);
+            if (fd < 0) continue;
+            if (current->leader < 0) current->leader = fd;
+            current->members.push_back(c);
+        }
+        if (current->leader < 0 && !warned.exchange(true)) {
+            cerr << "Hardwarové čítače nejsou dostupné (perf_event_open: " << strerror(errno) << ")" << endl;
+        }
+        lock_guard<mutex> lock(mtx);
+        threads.push_back(current);
+        return current;
+    }
+
+    // adds counts since the last read to the innermost running phase
+    static void account(ThreadCounters *t) {
+        struct {
+            uint64_t nr;
+            uint64_t values[PERF_COUNTER_CNT];
+        } group;
+        if (read(t->leader, &group, sizeof(group)) < 0) return;
+        for (uint64_t i = 0; i < group.nr && i < t->members.size(); i++) {
+            int c = t->members[i];
+            if (!t->running.empty()) t->counts[t->running.back()][c] += group.values[i] - t->last[c];
+            t->last[c] = group.values[i];
+        }
+    }
+
+public:
+    void begin(PerfPhase phase) {
+        ThreadCounters *t = thread();
+        if (t->leader < 0) return;
+        account(t);
+        t->running.push_back(phase);
+    }
+
+    void end() {
+        ThreadCounters *t = current;
+        if (!t || t->leader < 0) return;
+        account(t);
+        t->running.pop_back();
+    }
+
+    // counts of all threads that have entered a phase, PHASE_CNT * PERF_COUNTER_CNT per thread, then sets them to 0;
+    // called while no other thread is in a phase
+    vector<long> take() {
+        lock_guard<mutex> lock(mtx);
+        vector<long> all;
+        for (ThreadCounters *t : threads) {
+            all.insert(all.end(), &t->counts[0][0], &t->counts[0][0] + PHASE_CNT * PERF_COUNTER_CNT);
+            memset(t->counts, 0, sizeof(t->counts));
+        }
+        return all;
+    }
+};
+
+thread_local PerfCounters::ThreadCounters *PerfCounters::current = nullptr;
+
+PerfCounters perfCounters;
+#endif
+
+// counts hardware events of its lifetime to the phase, does nothing without -DPERF_COUNTERS
+class PerfScope {
+public:
+    explicit PerfScope(PerfPhase phase) {
+#ifdef PERF_COUNTERS
+        perfCounters.begin(phase);
+#else
+        (void) phase;
+#endif
+    }
+
+    ~PerfScope() {
+#ifdef PERF_COUNTERS
+        perfCounters.end();
+#endif
+    }
+};
+
+// time this process spent inside MPI communication calls [s], MPI is called from one thread only
+double commTime = 0;
+
+// adds its lifetime to commTime, hardware counters of it go to the communication phase
+class CommTimer {
+private:
+    PerfScope perf{PHASE_COMMUNICATION};
+    double start;
+
+public:
+    CommTimer() : start(MPI_Wtime()) {}
+
+    ~CommTimer() {
+        commTime += MPI_Wtime() - start;
+    }
+};
+
+// message buffers are allocated by MPI, so they can be registered for RDMA by the MPI implementation
+void ensureBufferSize(char **buf, int &bufLen, int bufLenNeeded) {
+    if (bufLen >= bufLenNeeded) return;
+    if (*buf) MPI_Free_mem(*buf);
+    MPI_Alloc_mem(bufLenNeeded, MPI_INFO_NULL, buf);
+    bufLen = bufLenNeeded;
+}
+
+/**
+ * Pool of buffers for non-blocking sends.
+ * Buffer is reused once the MPI_Isend from it has completed, pool grows when all buffers are in flight.
+ */
+class SendBufferPool {
+private:
+    struct Slot {
+        char *buf;
+        int bufLen;
+        MPI_Request request;
+    };
+    vector<Slot> slots;
+    MPI_Comm comm;
+
+public:
+    explicit SendBufferPool(MPI_Comm comm = MPI_COMM_WORLD) : comm(comm) {}
+
+    SendBufferPool(const SendBufferPool &) = delete;
+
+    SendBufferPool &operator=(const SendBufferPool &) = delete;
+
+    // returns free slot with buffer of at least bufLenNeeded bytes
+    int acquire(int bufLenNeeded) {
+        CommTimer timer;
+        int slot = -1;
+        for (size_t i = 0; i < slots.size() && slot == -1; i++) {
+            int done = 1;
+            if (slots[i].request != MPI_REQUEST_NULL) MPI_Test(&slots[i].request, &done, MPI_STATUS_IGNORE);
+            if (done) slot = int(i);
+        }
+        if (slot == -1) {
+            slots.push_back(Slot{nullptr, 0, MPI_REQUEST_NULL});
+            slot = int(slots.size() - 1);
+        }
+        ensureBufferSize(&slots[slot].buf, slots[slot].bufLen, bufLenNeeded);
+        return slot;
+    }
+
+    char *buffer(int slot) {
+        return slots[slot].buf;
+    }
+
+    int bufferLen(int slot) const {
+        return slots[slot].bufLen;
+    }
+
+    void send(int slot, int msgLen, int dest, int tag) {
+        CommTimer timer;
+        tracer.instant("send", "bytes", msgLen, "dest", dest, "tag", tag);
+        MPI_Isend(slots[slot].buf, msgLen, MPI_CHAR, dest, tag, comm, &slots[slot].request);
+    }
+
+    void waitAll() {
+        CommTimer timer;
+        for (auto &s : slots) MPI_Wait(&s.request, MPI_STATUS_IGNORE);
+    }
+
+    ~SendBufferPool() {
+        waitAll();
+        for (auto &s : slots) MPI_Free_mem(s.buf);
+    }
+};
+
+
+/**
+ * Binary instance file (pack) mapped to memory, written by tools/saj2bin.py, all numbers little-endian.
+ * Header: magic "SAJB", version, instance count, reserved (uint32 each), record offsets (uint64 * count).
+ * Record: rowLen, maxDepth, horse square, bishop square (uint32 each), pawn bitset (uint64 * ceil(rowLen^2 / 64)),
+ * square of (row, col) is row * rowLen + col.
+ * Packs stay mapped until the process exits, processes on one node share the mapped pages.
+ */
+class InstancePack {
+public:
+    static const uint32_t VERSION = 1;
+    static const size_t HEADER_LEN = 16;
+
+    struct Record {
+        uint32_t rowLen;
+        uint32_t maxDepth;
+        uint32_t horse;
+        uint32_t bishop;
+
+        bool hasPawn(int square) const {
+            const uint64_t *pawns = reinterpret_cast<const uint64_t *>(this + 1);
+            return (pawns[square / 64] >> (square % 64)) & 1;
+        }
+    };
+
+private:
+    string path;
+    const char *data;
+    size_t len;
+
+    InstancePack(const string &path, const char *data, size_t len) : path(path), data(data), len(len) {}
+
+    [[noreturn]] void fail(const string &message) const {
+        cerr << path << ": " << message << endl;
+        exit(1);
+    }
+
+public:
+    // nullptr if path is not a pack, packs are cached by path, exits on unknown version or truncated header
+    static const InstancePack *open(const string &path) {
+        static map<string, InstancePack *> packs;
+        auto it = packs.find(path);
+        if (it != packs.end()) return it->second;
+
+        InstancePack *pack = nullptr;
+        int fd = ::open(path.c_str(), O_RDONLY);
+        struct stat st;
+        if (fd >= 0 && fstat(fd, &st) == 0 && size_t(st.st_size) >= HEADER_LEN) {
+            void *mapped = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+            if (mapped != MAP_FAILED) {
+                if (memcmp(mapped, "SAJB", 4) == 0) pack = new InstancePack(path, (const char *) mapped, st.st_size);
+                else munmap(mapped, st.st_size);
+            }
+        }
+        if (fd >= 0) close(fd);
+        if (pack) {
+            uint32_t version = reinterpret_cast<const uint32_t *>(pack->data)[1];
+            if (version != VERSION) {
+                pack->fail("neznámá verze balíku " + to_string(version) + ", podporovaná je " + to_string(VERSION));
+            }
+            if (pack->len < HEADER_LEN + 8 * uint64_t(pack->count())) {
+                pack->fail("zkrácený balík, " + to_string(pack->len) + " bajtů nestačí na hlavičku s " +
+                           to_string(pack->count()) + " instancemi");
+            }
+        }
+        packs[path] = pack;
+        return pack;
+    }
+
+    uint32_t count() const {
+        return reinterpret_cast<const uint32_t *>(data)[2];
+    }
+
+    // exits if there is no such instance or its record does not fit in the pack
+    const Record &record(int index) const {
+        if (index < 0 || uint32_t(index) >= count()) {
+            fail("instance " + to_string(index) + " není v balíku s " + to_string(count()) + " instancemi");
+        }
+        uint64_t offset = reinterpret_cast<const uint64_t *>(data + HEADER_LEN)[index];
+        if (offset < HEADER_LEN + 8 * uint64_t(count()) || offset > len || len - offset < sizeof(Record)) {
+            fail("záznam instance " + to_string(index) + " na pozici " + to_string(offset) + " je mimo balík");
+        }
+        const Record &rec = *reinterpret_cast<const Record *>(data + offset);
+        uint64_t squares = uint64_t(rec.rowLen) * rec.rowLen;
+        if (len - offset - sizeof(Record) < 8 * ((squares + 63) / 64)) {
+            fail("záznam instance " + to_string(index) + " přesahuje konec balíku");
+        }
+        if (rec.horse >= squares || rec.bishop >= squares) {
+            fail("kůň nebo střelec instance " + to_string(index) + " je mimo šachovnici");
+        }
+        return rec;
+    }
+};
+
+class ChessBoard {
+private:
+    char grid[GRID_CAPACITY]; // rows of the side plus both borders, see square
+    int rowLen;
+    int pawnCnt;
+    int minDepth;
+
+    // PDP hint heuristic
+    int maxDepth;
+
+    // index of (row, col) in grid, N as in at<N>
+    template<int N>
+    int square(int row, int col) const {
+        return (row + BOARD_BORDER) * ((N ? N : rowLen) + 2 * BOARD_BORDER) + col + BOARD_BORDER;
+    }
+
+    // grid of EMPTY squares surrounded by BOARD_BORDER squares of INVALID_AT
+    void initGrid() {
+        memset(grid, INVALID_AT, sizeof(grid));
+        for (int row = 0; row < rowLen; row++) memset(grid + square<0>(row, 0), EMPTY, rowLen);
+    }
+
+    void setAt(int row, int col, char value) {
+        grid[square<0>(row, col)] = value;
+    }
+
+    class ChessMove {
+    private:
+        unsigned char row;
+        unsigned char col;
+        bool tookPawn;
+    public:
+        ChessMove(int row, int col, bool tookPawn) : row(row), col(col), tookPawn(tookPawn) {}
+
+        ChessMove() = default;
+
+        friend ostream &operator<<(ostream &os, const ChessMove &m) {
+            os << int(m.row) << "," << int(m.col);
+            if (m.tookPawn) os << " *";
+            return os;
+        }
+    };
+
+    class ChessPiece {
+    private:
+        int row;
+        int col;
+        char type;
+
+    public:
+        ChessPiece() = default;
+
+        ChessPiece(int row, int col, char type) : row(row), col(col), type(type) {}
+
+        int getRow() const {
+            return row;
+        }
+
+        int getCol() const {
+            return col;
+        }
+
+        char getType() const {
+            return type;
+        }
+
+        void setRow(int row) {
+            ChessPiece::row = row;
+        }
+
+        void setCol(int col) {
+            ChessPiece::col = col;
+        }
+
+    };
+
+    ChessPiece bishop;
+    ChessPiece horse;
+    // moves played from the initial board, stored in the board, so that it is a value without pointers
+    ChessMove moveLog[MAX_DEPTH];
+    int moveCnt = 0;
+
+    void logMovePiece(int row, int col) {
+        bool tookPawn = at(row, col) == PAWN;
+        moveLog[moveCnt++] = ChessMove(row, col, tookPawn);
+    }
+
+    void movePiece(ChessPiece &p, int row, int col) {
+        logMovePiece(row, col);
+        if (at(row, col) == PAWN) pawnCnt--;
+        setAt(row, col, p.getType());
+        setAt(p.getRow(), p.getCol(), EMPTY);
+        p.setRow(row);
+        p.setCol(col);
+    }
+
+    void loadRecord(const InstancePack::Record &rec) {
+        rowLen = rec.rowLen;
+        maxDepth = rec.maxDepth;
+        pawnCnt = 0;
+        initGrid();
+        for (int i = 0; i < rowLen * rowLen; i++) {
+            if (rec.hasPawn(i)) {
+                setAt(i / rowLen, i % rowLen, PAWN);
+                pawnCnt++;
+            }
+        }
+        horse = ChessPiece(rec.horse / rowLen, rec.horse % rowLen, HORSE);
+        bishop = ChessPiece(rec.bishop / rowLen, rec.bishop % rowLen, BISHOP);
+        setAt(horse.getRow(), horse.getCol(), HORSE);
+        setAt(bishop.getRow(), bishop.getCol(), BISHOP);
+        minDepth = pawnCnt;
+    }
+
+public:
+
+    // returned when accessing invalid position in chess board
+    const static char INVALID_AT = '\0';
+
+    // grid and move log are stored in the board, larger instances need larger limits at compile time
+    static void checkLimits(int rowLen, int maxDepth, const string &filename) {
+        if (rowLen > MAX_ROW_LEN) {
+            cerr << filename << ": šachovnice " << rowLen << "x" << rowLen << " je větší než podporovaná "
+                 << MAX_ROW_LEN << "x" << MAX_ROW_LEN << ", přeložte s -DMAX_ROW_LEN=" << rowLen << endl;
+            exit(1);
+        }
+        if (maxDepth > MAX_DEPTH) {
+            cerr << filename << ": maximální hloubka " << maxDepth << " je větší než podporovaná " << MAX_DEPTH
+                 << ", přeložte s -DMAX_DEPTH=" << maxDepth << endl;
+            exit(1);
+        }
+    }
+
+    // instance file in text format, or binary pack, "pack#i" is i-th instance of the pack
+    ChessBoard(const string &filename) {
+        size_t sep = filename.find_last_of('#');
+        const InstancePack *pack = InstancePack::open(filename.substr(0, sep));
+        if (pack) {
+            const InstancePack::Record &rec = pack->record(sep == string::npos ? 0 : stoi(filename.substr(sep + 1)));
+            checkLimits(rec.rowLen, rec.maxDepth, filename);
+            loadRecord(rec);
+            return;
+        }
+
+        ifstream ifs(filename);
+        ifs >> rowLen;
+        ifs >> maxDepth;
+        checkLimits(rowLen, maxDepth, filename);
+        pawnCnt = 0;
+        initGrid();
+
+        char c;
+        int idx = 0;
+        while (ifs.get(c) && idx < rowLen * rowLen) {
+            if (c != '\n' && c != '\r') {
+                int row = int(idx / rowLen);
+                int col = idx % rowLen;
+                if (c == BISHOP) bishop = ChessPiece(row, col, BISHOP);
+                if (c == HORSE) horse = ChessPiece(row, col, HORSE);
+                if (c == PAWN) pawnCnt++;
+                setAt(row, col, c);
+                idx++;
+            }
+        }
+        ifs.close();
+        minDepth = pawnCnt;
+    };
+
+    // plain value, copied (and sent between ranks) byte by byte, see serializeToBuffer
+    ChessBoard() = default;
+
+    // message holding the board is the board as it is in memory, ranks run the same binary
+    static int serializedSize() {
+        return sizeof(ChessBoard);
+    }
+
+    void serializeToBuffer(char *buf, int bufLen, int &written) const {
+        PerfScope perf(PHASE_SERIALIZATION);
+        memcpy(buf, this, sizeof(ChessBoard));
+        written = sizeof(ChessBoard);
+    }
+
+    static ChessBoard deserializeFromBuffer(const char *buf, int bufLen) {
+        PerfScope perf(PHASE_SERIALIZATION);
+        ChessBoard board;
+        memcpy(&board, buf, sizeof(ChessBoard));
+        return board;
+    }
+
+    // board of side N, or of side rowLen if N is 0, see DISPATCH_ROW_LEN
+    // with MAILBOX_BOARD squares off the board are read unchecked from the border, at most BOARD_BORDER away
+    template<int N>
+    char at(int row, int col) const {
+#ifndef MAILBOX_BOARD
+        const int n = N ? N : rowLen;
+        if (row < 0 || col < 0 || row >= n || col >= n) return INVALID_AT;
+#endif
+        return grid[square<N>(row, col)];
+    };
+
+    char at(int row, int col) const {
+        return at<0>(row, col);
+    };
+
+    void moveBishop(int row, int col) {
+        movePiece(bishop, row, col);
+    }
+
+    void moveHorse(int row, int col) {
+        movePiece(horse, row, col);
+    }
+
+    int getPawnCnt() const {
+        return pawnCnt;
+    }
+
+    int getMaxDepth() const {
+        return maxDepth;
+    }
+
+    const ChessPiece &getBishop() const {
+        return bishop;
+    }
+
+    const ChessPiece &getHorse() const {
+        return horse;
+    }
+
+    int getRowLen() const {
+        return rowLen;
+    }
+
+    vector<ChessMove> getMoveLog() const {
+        return vector<ChessMove>(moveLog, moveLog + moveCnt);
+    }
+
+    int getMoveCnt() const {
+        return moveCnt;
+    }
+
+    // FNV-1a hash of side length, max depth and grid as hex string, same for text and binary instance file
+    string hash() const {
+        uint64_t h = 14695981039346656037ULL;
+        auto mix = [&h](unsigned char byte) { h = (h ^ byte) * 1099511628211ULL; };
+        for (int shift = 0; shift < 32; shift += 8) mix((unsigned char) (rowLen >> shift));
+        for (int shift = 0; shift < 32; shift += 8) mix((unsigned char) (maxDepth >> shift));
+        for (int i = 0; i < rowLen * rowLen; i++) mix((unsigned char) at(i / rowLen, i % rowLen));
+        char buf[17];
+        snprintf(buf, sizeof(buf), "%016llx", (unsigned long long) h);
+        return buf;
+    }
+
+    friend ostream &operator<<(ostream &os, const ChessBoard &g) {
+        os << "Délka strany šachovnice: " << g.rowLen << endl;
+        os << "minimální hloubka: " << g.minDepth << ", maximální hloubka: " << g.maxDepth << endl;
+        os << "Kůň na (" << g.horse.getRow() << "," << g.horse.getCol() << ")" << endl;
+        os << "Střelec na (" << g.bishop.getRow() << "," << g.bishop.getCol() << ")" << endl;
+        os << "Počet pěšáků " << g.pawnCnt << endl;
+        for (int i = 0; i < g.rowLen * g.rowLen; i++) {
+            os << g.at(i / g.rowLen, i % g.rowLen);
+            if ((i + 1) % g.rowLen) os << " | ";
+            else os << endl;
+        }
+        return os;
+    }
+
+    int getMinDepth() const {
+        return minDepth;
+    }
+
+    int getPathLen() const {
+        if (getPawnCnt() != 0) {
+            return numeric_limits<int>::max();
+        } else {
+            return getMoveCnt();
+        }
+    }
+};
+
+// frontier vectors, task captures and messages copy boards byte by byte
+static_assert(is_trivially_copyable<ChessBoard>::value, "ChessBoard musí být triviálně kopírovatelná");
+
+struct Instance {
+    ChessBoard board;
+    int depth;
+    char play;
+    int bestPathLen;
+
+    Instance(const ChessBoard &board, int depth, char play, int bestPathLen) : board(board), depth(depth), play(play),
+                                                                               bestPathLen(bestPathLen) {}
+
+    int serializedSize() const {
+        return sizeof(depth) + sizeof(bestPathLen) + sizeof(play) + ChessBoard::serializedSize();
+    }
+
+    // upper bound on size of any message exchanged while solving this instance
+    int maxSerializedSize() const {
+        return sizeof(depth) + sizeof(bestPathLen) + sizeof(play) + ChessBoard::serializedSize();
+    }
+
+    void serializeToBuffer(char *buf, int bufLen, int &written) {
+        PerfScope perf(PHASE_SERIALIZATION);
+        char *head = buf;
+        int cnt;
+
+        memcpy(head, &depth, sizeof(depth));
+        head += sizeof(depth);
+
+        memcpy(head, &bestPathLen, sizeof(bestPathLen));
+        head += sizeof(bestPathLen);
+
+        *(head++) = play;
+
+        board.serializeToBuffer(head, bufLen - (head - buf), cnt);
+        head += cnt;
+
+        written = head - buf;
+    }
+
+    static Instance deserializeFromBuffer(char *buf, int bufLen) {
+        int read;
+        return deserializeFromBuffer(buf, bufLen, read);
+    }
+
+    static Instance deserializeFromBuffer(char *buf, int bufLen, int &read) {
+        PerfScope perf(PHASE_SERIALIZATION);
+        char *head = buf;
+
+        int depth;
+        memcpy(&depth, head, sizeof(depth));
+        head += sizeof(depth);
+
+        int bestPathLen;
+        memcpy(&bestPathLen, head, sizeof(bestPathLen));
+        head += sizeof(bestPathLen);
+
+        char play = *(head++);
+
+        ChessBoard board = ChessBoard::deserializeFromBuffer(head, bufLen - (head - buf));
+        head += ChessBoard::serializedSize();
+
+        read = head - buf;
+        return Instance(board, depth, play, bestPathLen);
+    }
+};
+
+class EvalPosition {
+public:
+    static int for_horse(const ChessBoard &g, int row, int col) {
+        DISPATCH_ROW_LEN(g, for_horse, g, row, col)
+    }
+
+    static int for_bishop(const ChessBoard &g, int row, int col) {
+        DISPATCH_ROW_LEN(g, for_bishop, g, row, col)
+    }
+
+    template<int N>
+    static int for_horse(const ChessBoard &g, int row, int col) {
+        // take pawn
+        if (g.at<N>(row, col) == PAWN) return 3;
+
+        // take pawn next move
+        for (const auto &cand : HORSE_CAND) {
+            if (g.at<N>(row + cand[0], col + cand[1]) == PAWN)
+                return 2;
+        }
+
+        // one square away from pawn
+        if (
+                g.at<N>(row + 1, col + 1) == PAWN ||
+                g.at<N>(row + 1, col - 1) == PAWN ||
+                g.at<N>(row + 1, col) == PAWN ||
+                g.at<N>(row - 1, col - 1) == PAWN ||
+                g.at<N>(row - 1, col + 1) == PAWN ||
+                g.at<N>(row - 1, col) == PAWN ||
+                g.at<N>(row, col + 1) == PAWN ||
+                g.at<N>(row, col - 1) == PAWN
+                )
+            return 1;
+
+        return 0;
+    };
+
+    template<int N>
+    static int for_bishop(const ChessBoard &g, int row, int col) {
+        if (g.at<N>(row, col) == PAWN) return 2;
+        char c;
+
+        // DIAG DOWN RIGHT
+        for (int i = 1;; i++) {
+            c = g.at<N>(row + i, col + i);
+            if (c == ChessBoard::INVALID_AT || c == HORSE) break;
+            if (c == PAWN) return 1;
+        }
+
+        // DIAG DOWN LEFT
+        for (int i = 1;; i++) {
+            c = g.at<N>(row + i, col - i);
+            if (c == ChessBoard::INVALID_AT || c == HORSE) break;
+            if (c == PAWN) return 1;
+        }
+
+        // DIAG UP RIGHT
+        for (int i = 1;; i++) {
+            c = g.at<N>(row - i, col + i);
+            if (c == ChessBoard::INVALID_AT || c == HORSE) break;
+            if (c == PAWN) return 1;
+        }
+
+        // DIAG UP LEFT
+        for (int i = 1;; i++) {
+            c = g.at<N>(row - i, col - i);
+            if (c == ChessBoard::INVALID_AT || c == HORSE) break;
+            if (c == PAWN) return 1;
+        }
+
+        return 0;
+    }
+
+
+};
+
+class NextPossibleMoves {
+public:
+
+    struct NextMove {
+        int row;
+        int col;
+        int cost;
+
+        NextMove() = default;
+
+        NextMove(int row, int col, int cost) : row(row), col(col), cost(cost) {}
+
+        template<int N, class Moves>
+        static bool add_bishop_if_possible(int row, int col, const ChessBoard &g, Moves &moves) {
+            char c = g.at<N>(row, col);
+            if (c == HORSE || c == ChessBoard::INVALID_AT) {
+                return false;
+            }
+            if (c == PAWN) {
+                moves.add(row, col, EvalPosition::for_bishop<N>(g, row, col));
+                return false;
+            }
+            if (c == EMPTY) {
+                moves.add(row, col, EvalPosition::for_bishop<N>(g, row, col));
+                return true;
+            }
+            return false;
+        }
+
+        template<int N, class Moves>
+        static bool add_horse_if_possible(int row, int col, const ChessBoard &g, Moves &moves) {
+            char c = g.at<N>(row, col);
+            if (c == EMPTY || c == PAWN) {
+                moves.add(row, col, EvalPosition::for_horse<N>(g, row, col));
+                return true;
+            }
+            return false;
+        }
+
+    };
+
+    // moves of one node in a fixed-capacity buffer, generating them does not allocate
+    template<int CAPACITY>
+    class MoveList {
+    private:
+        NextMove items[CAPACITY];
+        int cnt = 0;
+
+    public:
+        void add(int row, int col, int cost) {
+            items[cnt++] = NextMove(row, col, cost);
+        }
+
+        // counting sort on cost, highest first, moves of the same cost keep the order they were generated in
+        void sortByCost() {
+            int start[MAX_MOVE_COST + 2] = {};
+            for (int i = 0; i < cnt; i++) start[MAX_MOVE_COST - items[i].cost + 1]++;
+            for (int c = 1; c <= MAX_MOVE_COST + 1; c++) start[c] += start[c - 1];
+            NextMove sorted[CAPACITY];
+            for (int i = 0; i < cnt; i++) sorted[start[MAX_MOVE_COST - items[i].cost]++] = items[i];
+            copy(sorted, sorted + cnt, items);
+        }
+
+        size_t size() const {
+            return cnt;
+        }
+
+        bool empty() const {
+            return cnt == 0;
+        }
+
+        const NextMove &operator[](size_t i) const {
+            return items[i];
+        }
+
+        const NextMove *begin() const {
+            return items;
+        }
+
+        const NextMove *end() const {
+            return items + cnt;
+        }
+    };
+
+    typedef MoveList<HORSE_MOVE_CAPACITY> HorseMoves;
+    typedef MoveList<BISHOP_MOVE_CAPACITY> BishopMoves;
+
+    static HorseMoves for_horse(const ChessBoard &g) {
+        DISPATCH_ROW_LEN(g, for_horse, g)
+    }
+
+    static BishopMoves for_bishop(const ChessBoard &g) {
+        DISPATCH_ROW_LEN(g, for_bishop, g)
+    }
+
+    template<int N>
+    static HorseMoves for_horse(const ChessBoard &g) {
+        int row = g.getHorse().getRow();
+        int col = g.getHorse().getCol();
+        HorseMoves moves;
+        for (const auto &cand : HORSE_CAND) {
+            NextMove::add_horse_if_possible<N>(cand[0] + row, cand[1] + col, g, moves);
+        }
+
+        moves.sortByCost();
+        return moves;
+    };
+
+    template<int N>
+    static BishopMoves for_bishop(const ChessBoard &g) {
+        BishopMoves moves;
+        int row = g.getBishop().getRow();
+        int col = g.getBishop().getCol();
+
+        // DIAG UP RIGHT
+        for (int i = 1;; i++) {
+            if (!NextMove::add_bishop_if_possible<N>(row - i, col + i, g, moves)) break;
+        }
+
+        // DIAG UP LEFT
+        for (int i = 1;; i++) {
+            if (!NextMove::add_bishop_if_possible<N>(row - i, col - i, g, moves)) break;
+        }
+
+        // DIAG DOWN RIGHT
+        for (int i = 1;; i++) {
+            if (!NextMove::add_bishop_if_possible<N>(row + i, col + i, g, moves)) break;
+        }
+
+        // DIAG DOWN LEFT
+        for (int i = 1;; i++) {
+            if (!NextMove::add_bishop_if_possible<N>(row + i, col - i, g, moves)) break;
+        }
+
+        moves.sortByCost();
+        return moves;
+    };
+
+};
+
+// return true if there is better board available
+bool betterBoardExists(const Instance *ins, long bestPathLen) {
+    return
+            ins->depth + ins->board.getPawnCnt() >= bestPathLen || // solution with lower cost already exists
+            ins->depth + ins->board.getPawnCnt() > ins->board.getMaxDepth() ||
+            // max depth would be reached if each play would remove figure
+            bestPathLen == ins->board.getMinDepth(); // optimum was reached
+}
+
+/**
+ * Machine-readable summary of a run for the analysis pipeline, see --report.
+ * Appended to the report file as one JSON object per line, or as one CSV row if the file name ends with .csv
+ * (with header when the file is empty). Fields keep the order in which they were added.
+ */
+class RunReport {
+private:
+    vector<string> names;
+    vector<string> jsonValues;
+    vector<string> csvValues;
+
+    static string jsonQuote(const string &s) {
+        string quoted = "\"";
+        for (char c : s) {
+            if (c == '"' || c == '\\') quoted += '\\';
+            quoted += c;
+        }
+        return quoted + "\"";
+    }
+
+    static string csvQuote(const string &s) {
+        string quoted = "\"";
+        for (char c : s) {
+            if (c == '"') quoted += '"';
+            quoted += c;
+        }
+        return quoted + "\"";
+    }
+
+    void add(const string &name, const string &jsonValue, const string &csvValue) {
+        names.push_back(name);
+        jsonValues.push_back(jsonValue);
+        csvValues.push_back(csvValue);
+    }
+
+public:
+    void addCount(const string &name, long value) {
+        add(name, to_string(value), to_string(value));
+    }
+
+    // real value with 3 decimal places, times are in milliseconds
+    void addTime(const string &name, double value) {
+        char buf[32];
+        snprintf(buf, sizeof(buf), "%.3f", value);
+        add(name, buf, buf);
+    }
+
+    void addText(const string &name, const string &value) {
+        add(name, jsonQuote(value), csvQuote(value));
+    }
+
+    // items as printed by operator<<, JSON array of strings, in CSV joined by ';'
+    template<class T>
+    void addList(const string &name, const vector<T> &items) {
+        string json = "[", csv;
+        for (size_t i = 0; i < items.size(); i++) {
+            ostringstream item;
+            item << items[i];
+            json += (i ? ", " : "") + jsonQuote(item.str());
+            csv += (i ? ";" : "") + item.str();
+        }
+        add(name, json + "]", csvQuote(csv));
+    }
+
+    // JSON array of numbers, in CSV joined by ';'
+    void addCountList(const string &name, const vector<long> &values) {
+        string json = "[", csv;
+        for (size_t i = 0; i < values.size(); i++) {
+            json += (i ? ", " : "") + to_string(values[i]);
+            csv += (i ? ";" : "") + to_string(values[i]);
+        }
+        add(name, json + "]", csvQuote(csv));
+    }
+
+    void append(const string &path) const {
+        bool csv = path.size() > 4 && path.compare(path.size() - 4, 4, ".csv") == 0;
+        ifstream existing(path);
+        bool empty = existing.peek() == ifstream::traits_type::eof();
+        existing.close();
+
+        ofstream os(path, ios::app);
+        if (csv) {
+            if (empty) {
+                for (size_t i = 0; i < names.size(); i++) os << (i ? "," : "") << names[i];
+                os << endl;
+            }
+            for (size_t i = 0; i < csvValues.size(); i++) os << (i ? "," : "") << csvValues[i];
+            os << endl;
+        } else {
+            os << "{";
+            for (size_t i = 0; i < names.size(); i++) {
+                os << (i ? ", " : "") << jsonQuote(names[i]) << ": " << jsonValues[i];
+            }
+            os << "}" << endl;
+        }
+        if (!os) cerr << "Report se nepodařilo zapsat do " << path << endl;
+    }
+};
+
+#ifdef PROFILE_TREE
+#define PROFILE(statement) statement
+#define PROFILE_MAX_DEPTH 128 // deeper nodes are counted in the last level of the profile
+#else
+#define PROFILE(statement)
+#endif
+
+/**
+ * Counters of the search of one process, shared by its search threads.
+ * Pruned nodes are split by the first condition of betterBoardExists that cut them off.
+ * Profiling build (-DPROFILE_TREE) keeps the counters also per depth of the search tree, see printProfile.
+ */
+struct SearchStats {
+    long nodes = 0;
+    long prunedBound = 0;
+    long prunedMaxDepth = 0;
+    long prunedOptimum = 0;
+#ifdef PROFILE_TREE
+    struct Level {
+        long entered = 0;
+        long expanded = 0; // nodes whose moves were generated
+        long children = 0;
+        long prunedBound = 0;
+        long prunedMaxDepth = 0;
+        long prunedOptimum = 0;
+        long solutions = 0; // leaves without pawns, improving the best solution or not
+    };
+    Level levels[PROFILE_MAX_DEPTH];
+
+    Level &level(long depth) {
+        return levels[min(depth, long(PROFILE_MAX_DEPTH - 1))];
+    }
+
+    static string branching(long children, long expanded) {
+        char buf[32];
+        snprintf(buf, sizeof(buf), "%.2f", expanded ? double(children) / expanded : 0.0);
+        return buf;
+    }
+
+    // one row per depth, play is the piece moved from nodes of that depth (bishop moves first)
+    static void printLevels(ostream &os, const Level *levels) {
+        os << "Profil stromu prohledávání" << endl;
+        os << "Hloubka\tTah\tUzly\tRozvinuto\tVětvení\tOřez mez\tOřez maxDepth\tOřez optimum\tŘešení" << endl;
+        long expanded[2] = {0, 0}, children[2] = {0, 0}; // bishop, horse plies
+        for (int d = 0; d < PROFILE_MAX_DEPTH; d++) {
+            const Level &l = levels[d];
+            if (l.entered == 0) continue;
+            expanded[d % 2] += l.expanded;
+            children[d % 2] += l.children;
+            os << d << "\t" << (d % 2 ? HORSE : BISHOP) << "\t" << l.entered << "\t" << l.expanded << "\t\t"
+               << branching(l.children, l.expanded) << "\t" << l.prunedBound << "\t\t" << l.prunedMaxDepth
+               << "\t\t" << l.prunedOptimum << "\t\t" << l.solutions << endl;
+        }
+        os << "Průměrné větvení: " << BISHOP << " " << branching(children[0], expanded[0]) << ", " << HORSE << " "
+           << branching(children[1], expanded[1]) << endl << endl;
+    }
+
+    // columns of the profile as lists indexed by depth, up to the deepest level entered
+    static void addLevelsTo(RunReport &report, const Level *levels) {
+        int depths = PROFILE_MAX_DEPTH;
+        while (depths > 0 && levels[depths - 1].entered == 0) depths--;
+        const pair<const char *, long Level::*> columns[] = {
+                {"depth_nodes", &Level::entered},
+                {"depth_expanded", &Level::expanded},
+                {"depth_children", &Level::children},
+                {"depth_pruned_bound", &Level::prunedBound},
+                {"depth_pruned_max_depth", &Level::prunedMaxDepth},
+                {"depth_pruned_optimum", &Level::prunedOptimum},
+                {"depth_solutions", &Level::solutions},
+        };
+        for (const auto &column : columns) {
+            vector<long> values;
+            for (int d = 0; d < depths; d++) values.push_back(levels[d].*column.second);
+            report.addCountList(column.first, values);
+        }
+    }
+#endif
+
+    static void add(long &counter, long n = 1) {
+#pragma omp atomic update
+        counter += n;
+    }
+
+    void entered(long depth) {
+        PROFILE(add(level(depth).entered));
+    }
+
+    void expanded(long depth, long children) {
+        PROFILE(add(level(depth).expanded));
+        PROFILE(add(level(depth).children, children));
+    }
+
+    void solved(long depth) {
+        PROFILE(add(level(depth).solutions));
+    }
+
+    void pruned(const Instance *ins, long bestPathLen) {
+        if (ins->depth + ins->board.getPawnCnt() >= bestPathLen) {
+            add(prunedBound);
+            PROFILE(add(level(ins->depth).prunedBound));
+        } else if (ins->depth + ins->board.getPawnCnt() > ins->board.getMaxDepth()) {
+            add(prunedMaxDepth);
+            PROFILE(add(level(ins->depth).prunedMaxDepth));
+        } else {
+            add(prunedOptimum);
+            PROFILE(add(level(ins->depth).prunedOptimum));
+        }
+    }
+
+    // collective, counters summed over all processes are added on rank 0
+    void reduceTo(RunReport &report, int myRank) const {
+        long local[4] = {nodes, prunedBound, prunedMaxDepth, prunedOptimum};
+        long total[4];
+        MPI_Reduce(local, total, 4, MPI_LONG, MPI_SUM, 0, MPI_COMM_WORLD);
+        if (myRank == 0) {
+            report.addCount("nodes", total[0]);
+            report.addCount("pruned_bound", total[1]);
+            report.addCount("pruned_max_depth", total[2]);
+            report.addCount("pruned_optimum", total[3]);
+        }
+#ifdef PROFILE_TREE
+        Level levelsTotal[PROFILE_MAX_DEPTH];
+        MPI_Reduce(levels, levelsTotal, PROFILE_MAX_DEPTH * sizeof(Level) / sizeof(long), MPI_LONG, MPI_SUM, 0, MPI_COMM_WORLD);
+        if (myRank == 0) addLevelsTo(report, levelsTotal);
+#endif
+    }
+
+    // collective, profile summed over all processes is printed by rank 0, nothing unless built with -DPROFILE_TREE
+    void printProfile(int myRank) const {
+#ifdef PROFILE_TREE
+        Level levelsTotal[PROFILE_MAX_DEPTH];
+        MPI_Reduce(levels, levelsTotal, PROFILE_MAX_DEPTH * sizeof(Level) / sizeof(long), MPI_LONG, MPI_SUM, 0, MPI_COMM_WORLD);
+        if (myRank == 0) printLevels(cout, levelsTotal);
+#endif
+    }
+};
+
+#define NO_TIME_LIMIT 0
+
+/**
+ * Anytime mode, search stops at wall-clock deadline.
+ * Every expansion reads the clock, so no state is expanded and no improvement is streamed after the deadline,
+ * however the threads are scheduled. Nodes left unexplored because of the deadline keep the lowest lower bound
+ * (depth + pawn count) among them, over all processes it is the lower bound on the optimum.
+ */
+class Deadline {
+private:
+    int myRank;
+    chrono::steady_clock::time_point start;
+    chrono::steady_clock::time_point end;
+    double limit; // [s]
+    mutable atomic<bool> expired;
+    atomic<bool> finished;
+    long openBound;
+
+public:
+    Deadline(double limit, int myRank) : myRank(myRank), start(chrono::steady_clock::now()), limit(limit),
+                                         expired(false), finished(false), openBound(numeric_limits<long>::max()) {
+        end = start + chrono::duration_cast<chrono::steady_clock::duration>(chrono::duration<double>(limit));
+    }
+
+    Deadline(const Deadline &) = delete;
+
+    Deadline &operator=(const Deadline &) = delete;
+
+    // once expired stays expired, after finish the search is not cut any more
+    bool isExpired() const {
+        if (expired.load(memory_order_relaxed)) return true;
+        if (limit == NO_TIME_LIMIT || finished.load(memory_order_relaxed)) return false;
+        if (chrono::steady_clock::now() < end) return false;
+        expired = true;
+        return true;
+    }
+
+    void leaveOpen(long bound) {
+#pragma omp critical(openBound)
+        openBound = min(openBound, bound);
+    }
+
+    // called from the critical section updating bestPathLen, streams time-to-quality in anytime mode
+    void improved(long pathLen) {
+        if (limit == NO_TIME_LIMIT || isExpired()) return;
+        cout << myRank << ": Zlepšení: cena " << pathLen << " po "
+             << chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - start).count() << " ms"
+             << endl;
+    }
+
+    void finish() {
+        finished = true;
+    }
+
+    // collective, master prints lower bound on the optimum and optimality gap of its bestPathLen
+    void report(long bestPathLen) {
+        int expiredLocal = isExpired(), expiredAny;
+        long open;
+        MPI_Reduce(&expiredLocal, &expiredAny, 1, MPI_INT, MPI_MAX, 0, MPI_COMM_WORLD);
+        MPI_Reduce(&openBound, &open, 1, MPI_LONG, MPI_MIN, 0, MPI_COMM_WORLD);
+        if (myRank != 0 || !expiredAny) return;
+
+        long lower = min(bestPathLen, open);
+        cout << "Časový limit " << limit << " s vypršel" << endl;
+        cout << "Dolní mez ceny: " << lower << endl;
+        if (bestPathLen == numeric_limits<int>::max()) {
+            cout << "Mezera optimality: řešení nenalezeno" << endl;
+        } else {
+            printf("Mezera optimality: %ld (%.1f %%)\n", bestPathLen - lower, 100.0 * (bestPathLen - lower) / bestPathLen);
+            fflush(stdout);
+        }
+    }
+};
+
+#define PAWN_WORDS ((MAX_ROW_LEN * MAX_ROW_LEN + 63) / 64)
+
+/**
+ * Search state as key of the closed set. Zobrist hash only picks the bucket, states with the same hash are told
+ * apart by squares of the pieces, the pawns left and the side to move.
+ */
+struct StateKey {
+    uint64_t hash;
+    uint64_t pawns[PAWN_WORDS];
+    int horse;
+    int bishop;
+    char play;
+
+    bool operator==(const StateKey &other) const {
+        return hash == other.hash && horse == other.horse && bishop == other.bishop && play == other.play &&
+               equal(pawns, pawns + PAWN_WORDS, other.pawns);
+    }
+
+    struct Hash {
+        size_t operator()(const StateKey &key) const {
+            return key.hash;
+        }
+    };
+};
+
+/**
+ * Zobrist hashing of search states: positions of pieces, remaining pawns and side to move.
+ * Hash decides which rank owns the state, keys come from fixed seed so all ranks agree on them.
+ */
+class Zobrist {
+private:
+    vector<uint64_t> keys; // [cell * 3 + piece]
+    uint64_t bishopToMove;
+
+    static int pieceIdx(char c) {
+        if (c == HORSE) return 0;
+        if (c == BISHOP) return 1;
+        if (c == PAWN) return 2;
+        return -1;
+    }
+
+public:
+    explicit Zobrist(int size) : keys(3 * size) {
+        mt19937_64 gen(ZOBRIST_SEED);
+        for (auto &k : keys) k = gen();
+        bishopToMove = gen();
+    }
+
+    StateKey key(const Instance &ins) const {
+        const ChessBoard &g = ins.board;
+        int rowLen = g.getRowLen();
+        StateKey key = {ins.play == BISHOP ? bishopToMove : 0, {}, -1, -1, ins.play};
+        for (int row = 0; row < rowLen; row++) {
+            for (int col = 0; col < rowLen; col++) {
+                int square = row * rowLen + col;
+                int p = pieceIdx(g.at(row, col));
+                if (p < 0) continue;
+                key.hash ^= keys[3 * square + p];
+                if (p == 0) key.horse = square;
+                else if (p == 1) key.bishop = square;
+                else key.pawns[square / 64] |= uint64_t(1) << (square % 64);
+            }
+        }
+        return key;
+    }
+};
+
+// best-first on lower bound of path length (depth + pawns left), deeper states first on ties
+struct OpenComparator {
+    bool operator()(const Instance *a, const Instance *b) const {
+        int fa = a->depth + a->board.getPawnCnt();
+        int fb = b->depth + b->board.getPawnCnt();
+        if (fa != fb) return fa > fb;
+        return a->depth < b->depth;
+    }
+};
+
+/**
+ * Part of the search space owned by this rank, shared by all of its threads.
+ * Open list holds states to be expanded, closed set the lowest depth each owned state was reached at.
+ * States owned by other ranks wait in outgoing until the communication thread sends them in a batch.
+ */
+struct HdaRank {
+    int myRank;
+    int processCount;
+    const Zobrist &zobrist;
+    priority_queue<Instance *, vector<Instance *>, OpenComparator> open;
+    unordered_map<StateKey, int, StateKey::Hash> closed;
+    vector<vector<Instance *>> outgoing;
+    int expanding; // states being expanded right now
+    ChessBoard bestBoard;
+    long bestPathLen;
+    SearchStats stats; // nodes are expanded states
+    long duplicates; // states dropped by closed set
+    double busyTime; // summed over all search threads
+    bool finished;
+    Deadline &deadline;
+
+    HdaRank(int myRank, int processCount, const Zobrist &zobrist, const ChessBoard &board, Deadline &deadline) :
+            myRank(myRank), processCount(processCount), zobrist(zobrist), outgoing(processCount), expanding(0),
+            bestBoard(board), bestPathLen(numeric_limits<int>::max()), duplicates(0), busyTime(0),
+            finished(false), deadline(deadline) {}
+
+    // state owned by this rank goes to open list unless it was already reached at the same or lower depth
+    void addOwned(Instance *ins, const StateKey &key) {
+        bool duplicate;
+#pragma omp critical(hdaOpen)
+        {
+            auto it = closed.find(key);
+            duplicate = it != closed.end() && it->second <= ins->depth;
+            if (duplicate) {
+                duplicates++;
+            } else {
+                closed[key] = ins->depth;
+                open.push(ins);
+            }
+        }
+        if (duplicate) delete ins;
+    }
+
+    void add(Instance *ins) {
+        StateKey key = zobrist.key(*ins);
+        int owner = int(key.hash % processCount);
+        if (owner == myRank) {
+            addOwned(ins, key);
+        } else {
+#pragma omp critical(hdaOutgoing)
+            outgoing[owner].push_back(ins);
+        }
+    }
+
+    // returns state to expand or nullptr, caller must call expand on it
+    Instance *pop() {
+        Instance *ins = nullptr;
+#pragma omp critical(hdaOpen)
+        {
+            if (!open.empty()) {
+                ins = open.top();
+                open.pop();
+                expanding++;
+            }
+        }
+        return ins;
+    }
+
+    void expand(Instance *ins) {
+        stats.entered(ins->depth);
+        if (!betterBoardExists(ins, bestPathLen)) {
+            if (deadline.isExpired()) { // open list is drained without expanding, see Deadline
+                deadline.leaveOpen(ins->depth + ins->board.getPawnCnt());
+            } else if (ins->board.getPawnCnt() == 0) {
+                stats.solved(ins->depth);
+#pragma omp critical
+                {
+                    if (!betterBoardExists(ins, bestPathLen)) {
+                        bestPathLen = ins->depth;
+                        bestBoard = ins->board;
+                        deadline.improved(bestPathLen);
+                        tracer.instant("incumbent", "cost", bestPathLen);
+                    }
+                }
+            } else if (ins->play == HORSE) {
+                auto moves = NextPossibleMoves::for_horse(ins->board);
+                stats.expanded(ins->depth, moves.size());
+                for (const auto &m : moves) {
+                    ChessBoard cpy(ins->board);
+                    cpy.moveHorse(m.row, m.col);
+                    add(new Instance(cpy, ins->depth + 1, BISHOP, 0));
+                }
+            } else if (ins->play == BISHOP) {
+                auto moves = NextPossibleMoves::for_bishop(ins->board);
+                stats.expanded(ins->depth, moves.size());
+                for (const auto &m : moves) {
+                    ChessBoard cpy(ins->board);
+                    cpy.moveBishop(m.row, m.col);
+                    add(new Instance(cpy, ins->depth + 1, HORSE, 0));
+                }
+            }
+        } else {
+            stats.pruned(ins, bestPathLen);
+        }
+        delete ins;
+#pragma omp critical(hdaOpen)
+        {
+            expanding--;
+            stats.nodes++;
+        }
+    }
+
+    // true if there is nothing to expand, there may still be states to send
+    bool isSearchIdle() {
+        bool idle;
+#pragma omp critical(hdaOpen)
+        idle = open.empty() && expanding == 0;
+        return idle;
+    }
+
+    bool isIdle() {
+        bool idle = isSearchIdle();
+#pragma omp critical(hdaOutgoing)
+        {
+            for (const auto &out : outgoing) idle = idle && out.empty();
+        }
+        return idle;
+    }
+
+    void offerBestPathLen(long pathLen) {
+#pragma omp critical
+        {
+            if (pathLen < bestPathLen) bestPathLen = pathLen;
+        }
+    }
+};
+
+/*
+ * Batch of states sent to their owner:
+ * state count (int), [serialized length (int), serialized instance] * count
+ */
+class HdaCommunicator {
+private:
+    HdaRank &rank;
+    SendBufferPool sendPool;
+    char *recvBuf = nullptr;
+    int recvBufLen = 0;
+    long sentCnt = 0;
+    long recvCnt = 0;
+
+    // termination detection, see poll()
+    MPI_Request roundRequests[2];
+    bool roundActive = false;
+    long roundLocal[3]; // sent, received, busy
+    long roundTotal[3];
+    long previousTotal[3] = {-1, -1, -1};
+    long roundBestLocal;
+    long roundBest;
+    long announced = numeric_limits<int>::max(); // lowest bestPathLen other ranks know of
+
+    void sendBatch(int dest, vector<Instance *> &batch) {
+        int bufLenNeeded = sizeof(int);
+        for (const auto &ins : batch) bufLenNeeded += sizeof(int) + ins->serializedSize();
+
+        int slot = sendPool.acquire(bufLenNeeded);
+        char *head = sendPool.buffer(slot);
+        int cnt = batch.size();
+        memcpy(head, &cnt, sizeof(cnt));
+        head += sizeof(cnt);
+        for (const auto &ins : batch) {
+            int len;
+            ins->serializeToBuffer(head + sizeof(len), bufLenNeeded, len);
+            memcpy(head, &len, sizeof(len));
+            head += sizeof(len) + len;
+            delete ins;
+        }
+        sendPool.send(slot, head - sendPool.buffer(slot), dest, MessageTag::WORK);
+        sentCnt++;
+    }
+
+    void receiveMessage(const MPI_Status &status) {
+        int msgLen;
+        MPI_Get_count(&status, MPI_CHAR, &msgLen);
+        ensureBufferSize(&recvBuf, recvBufLen, msgLen);
+        {
+            CommTimer timer;
+            MPI_Recv(recvBuf, msgLen, MPI_CHAR, status.MPI_SOURCE, status.MPI_TAG, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+        }
+        tracer.instant("recv", "bytes", msgLen, "source", status.MPI_SOURCE, "tag", status.MPI_TAG);
+        recvCnt++;
+
+        if (status.MPI_TAG == MessageTag::INCUMBENT) {
+            long pathLen;
+            memcpy(&pathLen, recvBuf, sizeof(pathLen));
+            announced = min(announced, pathLen);
+            rank.offerBestPathLen(pathLen);
+            return;
+        }
+
+        char *head = recvBuf;
+        int cnt;
+        memcpy(&cnt, head, sizeof(cnt));
+        head += sizeof(cnt);
+        for (int i = 0; i < cnt; i++) {
+            int len;
+            memcpy(&len, head, sizeof(len));
+            head += sizeof(len);
+            Instance *ins = new Instance(Instance::deserializeFromBuffer(head, len));
+            head += len;
+            rank.addOwned(ins, rank.zobrist.key(*ins));
+        }
+    }
+
+public:
+    explicit HdaCommunicator(HdaRank &rank) : rank(rank) {}
+
+    HdaCommunicator(const HdaCommunicator &) = delete;
+
+    HdaCommunicator &operator=(const HdaCommunicator &) = delete;
+
+    // sends batches of HDA_BATCH_SIZE states, or all states if force is set, returns true if anything was sent
+    bool flush(bool force) {
+        bool sent = false;
+        for (int dest = 0; dest < rank.processCount; dest++) {
+            vector<Instance *> batch;
+#pragma omp critical(hdaOutgoing)
+            {
+                if (rank.outgoing[dest].size() >= HDA_BATCH_SIZE || (force && !rank.outgoing[dest].empty())) {
+                    batch.swap(rank.outgoing[dest]);
+                }
+            }
+            if (!batch.empty()) {
+                sendBatch(dest, batch);
+                sent = true;
+            }
+        }
+        return sent;
+    }
+
+    // sends bestPathLen to all other ranks once this rank has improved it, returns true if anything was sent
+    // counted as batches, so the search does not terminate with an improvement in flight
+    bool announce() {
+        long pathLen;
+#pragma omp critical
+        pathLen = rank.bestPathLen;
+        if (pathLen >= announced) return false;
+        announced = pathLen;
+        for (int dest = 0; dest < rank.processCount; dest++) {
+            if (dest == rank.myRank) continue;
+            int slot = sendPool.acquire(sizeof(pathLen));
+            memcpy(sendPool.buffer(slot), &pathLen, sizeof(pathLen));
+            sendPool.send(slot, sizeof(pathLen), dest, MessageTag::INCUMBENT);
+            sentCnt++;
+        }
+        return true;
+    }
+
+    // receives all pending batches and improvements of bestPathLen, returns true if there was any
+    bool receive() {
+        bool received = false;
+        int flag;
+        MPI_Status status;
+        for (int tag : {MessageTag::INCUMBENT, MessageTag::WORK}) { // improvements first, they prune the states
+            while (true) {
+                {
+                    CommTimer timer;
+                    MPI_Iprobe(MPI_ANY_SOURCE, tag, MPI_COMM_WORLD, &flag, &status);
+                }
+                if (!flag) break;
+                receiveMessage(status);
+                received = true;
+            }
+        }
+        return received;
+    }
+
+    /**
+     * One step of termination detection, returns true once the search is over.
+     * Ranks repeatedly sum up sent & received batch counts and busy flags with non-blocking allreduce.
+     * Search is over when two consecutive rounds see all ranks idle and the same counts with nothing in flight.
+     * Each round also spreads the global bestPathLen, in case an improvement has not been announced yet.
+     */
+    bool poll() {
+        CommTimer timer;
+        if (!roundActive) {
+            bool idle = rank.isIdle();
+            roundLocal[0] = sentCnt;
+            roundLocal[1] = recvCnt;
+            roundLocal[2] = idle ? 0 : 1;
+            roundBestLocal = rank.bestPathLen;
+            MPI_Iallreduce(roundLocal, roundTotal, 3, MPI_LONG, MPI_SUM, MPI_COMM_WORLD, &roundRequests[0]);
+            MPI_Iallreduce(&roundBestLocal, &roundBest, 1, MPI_LONG, MPI_MIN, MPI_COMM_WORLD, &roundRequests[1]);
+            roundActive = true;
+            return false;
+        }
+
+        int done;
+        MPI_Testall(2, roundRequests, &done, MPI_STATUSES_IGNORE);
+        if (!done) return false;
+        roundActive = false;
+        announced = min(announced, roundBest);
+        rank.offerBestPathLen(roundBest);
+
+        bool terminated = roundTotal[2] == 0 && roundTotal[0] == roundTotal[1] &&
+                          equal(roundTotal, roundTotal + 3, previousTotal);
+        copy(roundTotal, roundTotal + 3, previousTotal);
+        return terminated;
+    }
+
+    ~HdaCommunicator() {
+        sendPool.waitAll();
+        if (recvBuf) MPI_Free_mem(recvBuf);
+    }
+};
+
+/**
+ * Runs {PROCNUM} search threads and one communication thread (thread 0 of the team, the calling thread,
+ * so MPI is called only from the main thread).
+ */
+void runHda(HdaRank &rank) {
+    HdaCommunicator communicator(rank);
+
+#pragma omp parallel num_threads({PROCNUM} + 1) shared(rank, communicator, tracer) default(none)
+    {
+        if (omp_get_thread_num() == 0) {
+            while (true) {
+                // partial batches are sent only when there is nothing else to do
+                bool active = communicator.announce();
+                active = communicator.flush(rank.isSearchIdle()) || active;
+                active = communicator.receive() || active;
+                if (communicator.poll()) break;
+                if (!active) this_thread::sleep_for(chrono::microseconds(50));
+            }
+#pragma omp atomic write
+            rank.finished = true;
+        } else {
+            int64_t idleStart = -1; // waiting for a state since, in trace time
+            while (true) {
+                bool finished;
+#pragma omp atomic read
+                finished = rank.finished;
+                if (finished) break;
+
+                Instance *ins = rank.pop();
+                if (!ins) {
+                    if (idleStart < 0 && tracer.isStarted()) idleStart = tracer.now();
+                    this_thread::sleep_for(chrono::microseconds(50));
+                    continue;
+                }
+                if (idleStart >= 0) tracer.span("idle", idleStart);
+                idleStart = -1;
+                TraceSpan span("expand", "depth", ins->depth);
+                PerfScope perf(PHASE_SEARCH);
+                double tBusy = omp_get_wtime();
+                rank.expand(ins);
+                double busy = omp_get_wtime() - tBusy;
+#pragma omp atomic update
+                rank.busyTime += busy;
+            }
+            if (idleStart >= 0) tracer.span("idle", idleStart);
+        }
+    }
+}
+
+// fields perf_<phase>_<counter> summed over threads and perf_<phase>_<counter>_by_thread, counts hold
+// PHASE_CNT * PERF_COUNTER_CNT values for each of threads; phases no thread has counted in are left out
+void addPerfCounts(RunReport &report, const vector<long> &counts, const vector<string> &threads) {
+    const int perThread = PHASE_CNT * PERF_COUNTER_CNT;
+    bool threadsAdded = false;
+    for (int p = 0; p < PHASE_CNT; p++) {
+        bool counted = false;
+        for (size_t i = 0; i < counts.size(); i++) counted |= int(i % perThread) / PERF_COUNTER_CNT == p && counts[i];
+        if (!counted) continue;
+        if (!threadsAdded) report.addList("perf_threads", threads);
+        threadsAdded = true;
+        for (int c = 0; c < PERF_COUNTER_CNT; c++) {
+            string name = string("perf_") + PERF_PHASE_NAMES[p] + "_" + PERF_COUNTER_NAMES[c];
+            long total = 0;
+            vector<long> byThread;
+            for (size_t t = 0; t < threads.size(); t++) {
+                byThread.push_back(counts[t * perThread + p * PERF_COUNTER_CNT + c]);
+                total += byThread.back();
+            }
+            report.addCount(name, total);
+            report.addCountList(name + "_by_thread", byThread);
+        }
+    }
+}
+
+#ifdef PERF_COUNTERS
+// collective, hardware counters of threads of all ranks are added to the report of rank 0, thread is "rank.thread"
+void reducePerfCounts(RunReport &report, int myRank, int processCount) {
+    vector<long> mine = perfCounters.take();
+    int len = mine.size();
+    vector<int> lens(processCount), displs(processCount);
+    MPI_Gather(&len, 1, MPI_INT, lens.data(), 1, MPI_INT, 0, MPI_COMM_WORLD);
+    for (int i = 1; i < processCount; i++) displs[i] = displs[i - 1] + lens[i - 1];
+    vector<long> all(myRank == 0 ? displs[processCount - 1] + lens[processCount - 1] : 0);
+    MPI_Gatherv(mine.data(), len, MPI_LONG, all.data(), lens.data(), displs.data(), MPI_LONG, 0, MPI_COMM_WORLD);
+    if (myRank != 0) return;
+    vector<string> threads;
+    for (int i = 0; i < processCount; i++) {
+        for (int t = 0; t < lens[i] / (PHASE_CNT * PERF_COUNTER_CNT); t++) {
+            threads.push_back(to_string(i) + "." + to_string(t));
+        }
+    }
+    addPerfCounts(report, all, threads);
+}
+#endif
+
+// collective, events of all ranks are written by rank 0 to one trace, rank is the process id in the trace
+void writeTrace(const string &path, int myRank, int processCount) {
+    string mine = tracer.events(myRank, "rank " + to_string(myRank));
+    int len = mine.size();
+    vector<int> lens(processCount), displs(processCount);
+    MPI_Gather(&len, 1, MPI_INT, lens.data(), 1, MPI_INT, 0, MPI_COMM_WORLD);
+    for (int i = 1; i < processCount; i++) displs[i] = displs[i - 1] + lens[i - 1];
+    string all(myRank == 0 ? displs[processCount - 1] + lens[processCount - 1] : 0, ' ');
+    MPI_Gatherv(&mine[0], len, MPI_CHAR, &all[0], lens.data(), displs.data(), MPI_CHAR, 0, MPI_COMM_WORLD);
+    if (myRank != 0) return;
+    string events;
+    for (int i = 0; i < processCount; i++) events += (i ? ",\n" : "") + all.substr(displs[i], lens[i]);
+    Tracer::write(path, events);
+}
+
+// best board of all processes ends up on master
+void gatherBestBoard(ChessBoard &bestBoard, int msgCapacity) {
+    CommTimer timer;
+    int myRank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &myRank);
+
+    struct {
+        int pathLen;
+        int rank;
+    } mine{bestBoard.getPathLen(), myRank}, best;
+    MPI_Allreduce(&mine, &best, 1, MPI_2INT, MPI_MINLOC, MPI_COMM_WORLD);
+    if (best.rank == 0 || (myRank != 0 && myRank != best.rank)) return;
+
+    char *buf = nullptr;
+    int bufLen = 0;
+    ensureBufferSize(&buf, bufLen, msgCapacity);
+    if (myRank == 0) {
+        MPI_Recv(buf, bufLen, MPI_CHAR, best.rank, MessageTag::UPDATE, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+        bestBoard = ChessBoard::deserializeFromBuffer(buf, bufLen);
+    } else {
+        int msgLen;
+        bestBoard.serializeToBuffer(buf, bufLen, msgLen);
+        MPI_Send(buf, msgLen, MPI_CHAR, 0, MessageTag::UPDATE, MPI_COMM_WORLD);
+    }
+    MPI_Free_mem(buf);
+}
+
+int main(int argc, char **argv) {
+    // MPI is called only from the main thread, which is also the communication thread
+    int threadSupport;
+    MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &threadSupport);
+    int myRank, processCount;
+    MPI_Comm_rank(MPI_COMM_WORLD, &myRank);
+    MPI_Comm_size(MPI_COMM_WORLD, &processCount);
+
+    if (myRank == 0 && threadSupport < MPI_THREAD_FUNNELED) {
+        cerr << "MPI nepodporuje MPI_THREAD_FUNNELED" << endl;
+    }
+
+    // arguments: [--time-limit=SECONDS] [--report=FILE] [--trace=FILE] instance_file
+    // with time limit the search stops at the deadline and reports the best solution found and its optimality gap
+    // with report file rank 0 appends a summary of the run to it, see RunReport
+    // with trace file rank 0 writes a timeline of all ranks to it at exit, see Tracer
+    string filename, reportPath, tracePath;
+    double timeLimit = NO_TIME_LIMIT;
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg.compare(0, 13, "--time-limit=") == 0) timeLimit = stod(arg.substr(13));
+        else if (arg.compare(0, 9, "--report=") == 0) reportPath = arg.substr(9);
+        else if (arg.compare(0, 8, "--trace=") == 0) tracePath = arg.substr(8);
+        else filename = arg;
+    }
+    MPI_Barrier(MPI_COMM_WORLD); // trace times of all ranks start together
+    if (!tracePath.empty()) tracer.start();
+
+    /* time measuring - start */
+    double t1 = MPI_Wtime();
+    Deadline deadline(timeLimit, myRank);
+
+    ChessBoard board(filename);
+    double tLoaded = MPI_Wtime();
+    Instance startInstance(board, 0, BISHOP, numeric_limits<int>::max());
+    Zobrist zobrist(board.getRowLen() * board.getRowLen());
+    HdaRank rank(myRank, processCount, zobrist, board, deadline);
+
+    // start state is put to open list of its owner only
+    StateKey key = zobrist.key(startInstance);
+    if (int(key.hash % processCount) == myRank) rank.addOwned(new Instance(startInstance), key);
+
+    if (myRank == 0) {
+        cout << "Počet procesů: " << processCount << endl;
+    }
+
+    double tStarted = MPI_Wtime();
+    runHda(rank);
+
+    ChessBoard bestBoard(rank.bestBoard);
+    gatherBestBoard(bestBoard, startInstance.maxSerializedSize());
+    double tSearched = MPI_Wtime();
+    deadline.finish();
+    deadline.report(bestBoard.getPathLen());
+
+    long stats[2] = {rank.stats.nodes, rank.duplicates};
+    long statsTotal[2];
+    MPI_Reduce(stats, statsTotal, 2, MPI_LONG, MPI_SUM, 0, MPI_COMM_WORLD);
+
+    if (myRank == 0) {
+        cout << "Počet expandovaných stavů: " << statsTotal[0] << endl;
+        cout << "Počet duplicitních stavů: " << statsTotal[1] << endl;
+        cout << "===========ŘEŠENÍ============" << endl;
+        cout << "Počet tahů: " << bestBoard.getMoveLog().size() << endl;
+        for (const auto &move : bestBoard.getMoveLog()) {
+            cout << move << endl;
+        }
+        cout << "==============================" << endl;
+    }
+    rank.stats.printProfile(myRank);
+
+    // states left in open list could not lead to a better solution
+    while (!rank.open.empty()) {
+        delete rank.open.top();
+        rank.open.pop();
+    }
+
+    /* time measuring - stop */
+    double t2 = MPI_Wtime();
+    printf ("%d: Elapsed time is %f.\n",myRank,t2-t1);
+
+    // utilisation of each process = time spent expanding per search thread / elapsed time
+    double busyTime = rank.busyTime / {PROCNUM};
+    double elapsed = t2 - t1;
+    vector<double> busyTimes(processCount);
+    vector<double> elapsedTimes(processCount);
+    MPI_Gather(&busyTime, 1, MPI_DOUBLE, busyTimes.data(), 1, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+    MPI_Gather(&elapsed, 1, MPI_DOUBLE, elapsedTimes.data(), 1, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+    if (myRank == 0) {
+        cout << "===========VYTÍŽENÍ===========" << endl;
+        for (int i = 0; i < processCount; i++) {
+            printf("%d: Utilisation is %.1f %% (%f of %f).\n", i, 100 * busyTimes[i] / elapsedTimes[i],
+                   busyTimes[i], elapsedTimes[i]);
+        }
+        cout << "==============================" << endl;
+    }
+
+    if (!reportPath.empty()) {
+        // phases of rank 0, except communication, which is the longest of all ranks
+        double maxCommTime;
+        MPI_Reduce(&commTime, &maxCommTime, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+        RunReport report;
+        if (myRank == 0) {
+            report.addText("engine", "mpi-hda");
+            report.addCount("threads", {PROCNUM});
+            report.addCount("ranks", processCount);
+            report.addText("instance", filename);
+            report.addText("instance_hash", board.hash());
+            report.addCount("cost", bestBoard.getPawnCnt() == 0 ? bestBoard.getPathLen() : -1);
+        }
+        rank.stats.reduceTo(report, myRank);
+#ifdef PERF_COUNTERS
+        reducePerfCounts(report, myRank, processCount);
+#endif
+        if (myRank == 0) {
+            report.addCount("duplicates", statsTotal[1]);
+            report.addTime("load_ms", 1000 * (tLoaded - t1));
+            report.addTime("frontier_ms", 1000 * (tStarted - tLoaded));
+            report.addTime("search_ms", 1000 * (tSearched - tStarted));
+            report.addTime("comm_ms", 1000 * maxCommTime);
+            report.addList("moves", bestBoard.getMoveLog());
+            report.append(reportPath);
+        }
+    }
+
+    if (!tracePath.empty()) writeTrace(tracePath, myRank, processCount);
+    MPI_Finalize();
+    return 0;
+}
@@ -5,8 +5,26 @@
 #include <limits>
 #include <chrono>
 #include <algorithm>
+#include <cstdint>
+#include <map>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <type_traits>
+#include <deque>
+#include <sstream>
+#include <cstdio>
 #include <omp.h>
 #include "mpi.h"
+#ifdef PERF_COUNTERS
+#include <cerrno>
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#endif
 
 // chess pieces
 #define HORSE  'J'
@@ -14,14 +32,50 @@
 #define PAWN 'P'
 #define EMPTY '-'
 
+#ifndef MAX_ROW_LEN
+#define MAX_ROW_LEN 16 // longest side of a board, bounds the grid of ChessBoard and the move lists
+#endif
+#ifndef MAX_DEPTH
+#define MAX_DEPTH 64 // largest max depth of an instance, bounds the move log of ChessBoard
+#endif
+#define HORSE_MOVE_CAPACITY 8
+#define BISHOP_MOVE_CAPACITY (2 * (MAX_ROW_LEN - 1)) // both diagonals through the square
+#define MAX_MOVE_COST 3 // of EvalPosition
+#ifdef MAILBOX_BOARD
+#define BOARD_BORDER 2 // sentinel rows and columns around the grid, a horse jump from the board stays in them
+#else
+#define BOARD_BORDER 0
+#endif
+#define GRID_CAPACITY ((MAX_ROW_LEN + 2 * BOARD_BORDER) * (MAX_ROW_LEN + 2 * BOARD_BORDER))
+
+// returns fn<N>(args...) with N the side of board g, kernels of the sizes we run are specialised at compile time
+// (constant index arithmetic and bounds), other sizes use fn<0>, which reads the side from the board
+#define DISPATCH_ROW_LEN(g, fn, ...) \
+    switch ((g).getRowLen()) { \
+        case 5: return fn<5>(__VA_ARGS__); \
+        case 6: return fn<6>(__VA_ARGS__); \
+        case 7: return fn<7>(__VA_ARGS__); \
+        case 8: return fn<8>(__VA_ARGS__); \
+        case 9: return fn<9>(__VA_ARGS__); \
+        case 10: return fn<10>(__VA_ARGS__); \
+        case 11: return fn<11>(__VA_ARGS__); \
+        case 12: return fn<12>(__VA_ARGS__); \
+        case 13: return fn<13>(__VA_ARGS__); \
+        case 14: return fn<14>(__VA_ARGS__); \
+        case 15: return fn<15>(__VA_ARGS__); \
+        case 16: return fn<16>(__VA_ARGS__); \
+        default: return fn<0>(__VA_ARGS__); \
+    }
+
 /**
  * MPI message TAGs
  */
 enum MessageTag {
-    DONE = 0, // work is done
+    DONE = 0, // request for more work, carries best solution found by slave so far
     WORK = 1, // work to be done
     FINISHED = 2, // there is no more work
-    UPDATE = 3 // update on the bestPathLen solution found by slave on it's instance
+    UPDATE = 3, // final bestPathLen solution found by slave on all of it's instances
+    CHECKPOINT = 4 // request for / reply with state of slave, see CheckpointWriter
 };
 
 
@@ -43,19 +97,531 @@ const int HORSE_CAND[8][2] = {
 
 #define EPOCH_CNT 3
 
+#define CHECKPOINT_DEPTH 8 // number of DFS levels below instance whose position is saved to checkpoint
+#define CHECKPOINT_PERIOD 60 // default period of saving checkpoint [s]
+
 using namespace std;
 
+#define TRACE_CAPACITY 65536 // events kept per thread, older ones are overwritten
+
+/**
+ * Opt-in timeline of the run (--trace=FILE) in Chrome trace JSON format, open it in ui.perfetto.dev or chrome://tracing.
+ * Each thread records events to its own ring buffer without locking, only the last TRACE_CAPACITY events of each
+ * thread are kept. Until the tracer is started, recording an event costs a single branch.
+ */
+class Tracer {
+public:
+    // span if dur >= 0, instant event otherwise; names are string literals, unused arguments have no name
+    struct Event {
+        const char *name;
+        int64_t start; // [ns] since start()
+        int64_t dur; // [ns]
+        const char *argNames[3];
+        long args[3];
+    };
+
+private:
+    struct Ring {
+        int tid;
+        vector<Event> events;
+        long written; // events[written % TRACE_CAPACITY] is overwritten next
+    };
+
+    static thread_local Ring *ring;
+    bool started = false;
+    chrono::steady_clock::time_point origin;
+    mutex mtx; // guards rings
+    vector<Ring *> rings;
+
+    void record(const Event &e) {
+        if (!ring) {
+            lock_guard<mutex> lock(mtx);
+            ring = new Ring{int(rings.size()), vector<Event>(TRACE_CAPACITY), 0};
+            rings.push_back(ring);
+        }
+        ring->events[ring->written++ % TRACE_CAPACITY] = e;
+    }
+
+public:
+    // called before any other thread records, so started is never written concurrently
+    void start() {
+        origin = chrono::steady_clock::now();
+        started = true;
+    }
+
+    bool isStarted() const {
+        return started;
+    }
+
+    int64_t now() const {
+        return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - origin).count();
+    }
+
+    void instant(const char *name, const char *arg0 = nullptr, long val0 = 0, const char *arg1 = nullptr,
+                 long val1 = 0, const char *arg2 = nullptr, long val2 = 0) {
+        if (started) record(Event{name, now(), -1, {arg0, arg1, arg2}, {val0, val1, val2}});
+    }
+
+    // span from start, as returned by now(), until now
+    void span(const char *name, int64_t start, const char *arg0 = nullptr, long val0 = 0,
+              const char *arg1 = nullptr, long val1 = 0) {
+        if (started) record(Event{name, start, now() - start, {arg0, arg1, nullptr}, {val0, val1, 0}});
+    }
+
+    // recorded events as comma separated trace event objects, pid is the process of the trace they belong to
+    string events(int pid, const string &processName) {
+        lock_guard<mutex> lock(mtx);
+        char buf[256];
+        snprintf(buf, sizeof(buf), "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"args\":{\"name\":\"%s\"}}",
+                 pid, processName.c_str());
+        string out = buf;
+        for (const Ring *r : rings) {
+            long first = max(0L, r->written - TRACE_CAPACITY);
+            if (first > 0) cerr << "Trace: vlákno " << r->tid << " přepsalo " << first << " nejstarších událostí" << endl;
+            for (long i = first; i < r->written; i++) {
+                const Event &e = r->events[i % TRACE_CAPACITY];
+                snprintf(buf, sizeof(buf), ",\n{\"name\":\"%s\",\"ph\":\"%s\",\"pid\":%d,\"tid\":%d,\"ts\":%.3f", e.name,
+                         e.dur < 0 ? "i" : "X", pid, r->tid, e.start / 1000.0);
+                out += buf;
+                if (e.dur < 0) {
+                    out += ",\"s\":\"t\"";
+                } else {
+                    snprintf(buf, sizeof(buf), ",\"dur\":%.3f", e.dur / 1000.0);
+                    out += buf;
+                }
+                out += ",\"args\":{";
+                for (int a = 0; a < 3 && e.argNames[a]; a++) {
+                    snprintf(buf, sizeof(buf), "%s\"%s\":%ld", a ? "," : "", e.argNames[a], e.args[a]);
+                    out += buf;
+                }
+                out += "}}";
+            }
+        }
+        return out;
+    }
+
+    static void write(const string &path, const string &events) {
+        ofstream os(path);
+        os << "{\"traceEvents\":[\n" << events << "\n],\"displayTimeUnit\":\"ms\"}" << endl;
+        if (!os) cerr << "Trace se nepodařilo zapsat do " << path << endl;
+    }
+};
+
+thread_local Tracer::Ring *Tracer::ring = nullptr;
+
+Tracer tracer;
+
+// records its lifetime as a span
+class TraceSpan {
+private:
+    const char *name;
+    int64_t start;
+    const char *argName;
+    long arg;
+
+public:
+    explicit TraceSpan(const char *name, const char *argName = nullptr, long arg = 0) :
+            name(name), start(tracer.isStarted() ? tracer.now() : 0), argName(argName), arg(arg) {}
+
+    ~TraceSpan() {
+        tracer.span(name, start, argName, arg);
+    }
+};
+
+// phases of the run measured by PerfCounters
+enum PerfPhase {
+    PHASE_FRONTIER = 0, // generating instances searched in parallel
+    PHASE_SEARCH = 1,
+    PHASE_SERIALIZATION = 2, // of boards and instances to and from messages
+    PHASE_COMMUNICATION = 3, // inside MPI calls
+    PHASE_CNT = 4
+};
+
+#define PERF_COUNTER_CNT 5
+
+const char *const PERF_PHASE_NAMES[PHASE_CNT] = {"frontier", "search", "serialization", "communication"};
+const char *const PERF_COUNTER_NAMES[PERF_COUNTER_CNT] = {"cycles", "instructions", "l1d_misses", "llc_misses",
+                                                          "branch_misses"};
+
+#ifdef PERF_COUNTERS
+/**
+ * Hardware performance counters of each thread split by phase of the run, built with -DPERF_COUNTERS (Linux only).
+ * Each thread opens its own group of counters by perf_event_open when it first enters a phase. Counts since the
+ * last read are added to the innermost phase the thread is in whenever it enters or leaves a phase, so nested
+ * phases are not counted twice and code outside of all phases is not counted at all.
+ * Counters the machine does not provide (e.g. in a virtual machine) stay 0.
+ */
+class PerfCounters {
+private:
+    struct ThreadCounters {
+        int leader; // fd of the group, -1 if no counter could be opened
+        vector<int> members; // counter of each value read from the group, in order of opening
+        uint64_t last[PERF_COUNTER_CNT];
+        long counts[PHASE_CNT][PERF_COUNTER_CNT];
+        vector<PerfPhase> running;
+    };
+
+    static thread_local ThreadCounters *current;
+    mutex mtx; // guards threads
+    vector<ThreadCounters *> threads;
+    atomic<bool> warned{false};
+
+    static int open(uint32_t type, uint64_t config, int groupFd) {
+        perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = type;
+        attr.config = config;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_GROUP;
+        return syscall(__NR_perf_event_open, &attr, 0, -1, groupFd, 0);
+    }
+
+    ThreadCounters *thread() {
+        if (current) return current;
+        const uint64_t events[PERF_COUNTER_CNT][2] = {
+                {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+                {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+                {PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                                     (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)},
+                {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+                {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+        };
+        current = new ThreadCounters();
+        current->leader = -1;
+        for (int c = 0; c < PERF_COUNTER_CNT; c++) {
+            int fd = open(events[c][0], events[c][1], current->leader);
+            if (fd < 0) continue;
+            if (current->leader < 0) current->leader = fd;
+            current->members.push_back(c);
+        }
+        if (current->leader < 0 && !warned.exchange(true)) {
+            cerr << "Hardwarové čítače nejsou dostupné (perf_event_open: " << strerror(errno) << ")" << endl;
+        }
+        lock_guard<mutex> lock(mtx);
+        threads.push_back(current);
+        return current;
+    }
+
+    // adds counts since the last read to the innermost running phase
+    static void account(ThreadCounters *t) {
+        struct {
+            uint64_t nr;
+            uint64_t values[PERF_COUNTER_CNT];
+        } group;
+        if (read(t->leader, &group, sizeof(group)) < 0) return;
+        for (uint64_t i = 0; i < group.nr && i < t->members.size(); i++) {
+            int c = t->members[i];
+            if (!t->running.empty()) t->counts[t->running.back()][c] += group.values[i] - t->last[c];
+            t->last[c] = group.values[i];
+        }
+    }
+
+public:
+    void begin(PerfPhase phase) {
+        ThreadCounters *t = thread();
+        if (t->leader < 0) return;
+        account(t);
+        t->running.push_back(phase);
+    }
+
+    void end() {
+        ThreadCounters *t = current;
+        if (!t || t->leader < 0) return;
+        account(t);
+        t->running.pop_back();
+    }
+
+    // counts of all threads that have entered a phase, PHASE_CNT * PERF_COUNTER_CNT per thread, then sets them to 0;
+    // called while no other thread is in a phase
+    vector<long> take() {
+        lock_guard<mutex> lock(mtx);
+        vector<long> all;
+        for (ThreadCounters *t : threads) {
+            all.insert(all.end(), &t->counts[0][0], &t->counts[0][0] + PHASE_CNT * PERF_COUNTER_CNT);
+            memset(t->counts, 0, sizeof(t->counts));
+        }
+        return all;
+    }
+};
+
+thread_local PerfCounters::ThreadCounters *PerfCounters::current = nullptr;
+
+PerfCounters perfCounters;
+#endif
+
+// counts hardware events of its lifetime to the phase, does nothing without -DPERF_COUNTERS
+class PerfScope {
+public:
+    explicit PerfScope(PerfPhase phase) {
+#ifdef PERF_COUNTERS
+        perfCounters.begin(phase);
+#else
+        (void) phase;
+#endif
+    }
+
+    ~PerfScope() {
+#ifdef PERF_COUNTERS
+        perfCounters.end();
+#endif
+    }
+};
+
+// time this process spent inside MPI communication calls [s], MPI is called from one thread only
+double commTime = 0;
+
+// adds its lifetime to commTime, hardware counters of it go to the communication phase
+class CommTimer {
+private:
+    PerfScope perf{PHASE_COMMUNICATION};
+    double start;
+
+public:
+    CommTimer() : start(MPI_Wtime()) {}
+
+    ~CommTimer() {
+        commTime += MPI_Wtime() - start;
+    }
+};
+
+// message buffers are allocated by MPI, so they can be registered for RDMA by the MPI implementation
 void ensureBufferSize(char **buf, int &bufLen, int bufLenNeeded) {
     if (bufLen >= bufLenNeeded) return;
-    delete[] *buf;
-    *buf = new char[bufLenNeeded];
+    if (*buf) MPI_Free_mem(*buf);
+    MPI_Alloc_mem(bufLenNeeded, MPI_INFO_NULL, buf);
     bufLen = bufLenNeeded;
 }
 
+/**
+ * Pool of buffers for non-blocking sends.
+ * Buffer is reused once the MPI_Isend from it has completed, pool grows when all buffers are in flight.
+ */
+class SendBufferPool {
+private:
+    struct Slot {
+        char *buf;
+        int bufLen;
+        MPI_Request request;
+    };
+    vector<Slot> slots;
+    MPI_Comm comm;
+
+public:
+    explicit SendBufferPool(MPI_Comm comm = MPI_COMM_WORLD) : comm(comm) {}
+
+    SendBufferPool(const SendBufferPool &) = delete;
+
+    SendBufferPool &operator=(const SendBufferPool &) = delete;
+
+    // returns free slot with buffer of at least bufLenNeeded bytes
+    int acquire(int bufLenNeeded) {
+        CommTimer timer;
+        int slot = -1;
+        for (size_t i = 0; i < slots.size() && slot == -1; i++) {
+            int done = 1;
+            if (slots[i].request != MPI_REQUEST_NULL) MPI_Test(&slots[i].request, &done, MPI_STATUS_IGNORE);
+            if (done) slot = int(i);
+        }
+        if (slot == -1) {
+            slots.push_back(Slot{nullptr, 0, MPI_REQUEST_NULL});
+            slot = int(slots.size() - 1);
+        }
+        ensureBufferSize(&slots[slot].buf, slots[slot].bufLen, bufLenNeeded);
+        return slot;
+    }
+
+    char *buffer(int slot) {
+        return slots[slot].buf;
+    }
+
+    int bufferLen(int slot) const {
+        return slots[slot].bufLen;
+    }
+
+    void send(int slot, int msgLen, int dest, int tag) {
+        CommTimer timer;
+        tracer.instant("send", "bytes", msgLen, "dest", dest, "tag", tag);
+        MPI_Isend(slots[slot].buf, msgLen, MPI_CHAR, dest, tag, comm, &slots[slot].request);
+    }
+
+    void waitAll() {
+        CommTimer timer;
+        for (auto &s : slots) MPI_Wait(&s.request, MPI_STATUS_IGNORE);
+    }
+
+    ~SendBufferPool() {
+        waitAll();
+        for (auto &s : slots) MPI_Free_mem(s.buf);
+    }
+};
+
+/**
+ * Persistent receive request of any tag from given source within comm.
+ * Request is started right away, after a message has been processed it must be started again by restart().
+ */
+class PersistentReceive {
+private:
+    char *buf = nullptr;
+    int bufLen = 0;
+    MPI_Request request;
+    bool active;
+
+    void traceReceived(const MPI_Status &status) {
+        if (!tracer.isStarted()) return;
+        int msgLen;
+        MPI_Get_count(&status, MPI_CHAR, &msgLen);
+        tracer.instant("recv", "bytes", msgLen, "source", status.MPI_SOURCE, "tag", status.MPI_TAG);
+    }
+
+public:
+    PersistentReceive(int capacity, int source, MPI_Comm comm = MPI_COMM_WORLD) {
+        ensureBufferSize(&buf, bufLen, capacity);
+        MPI_Recv_init(buf, bufLen, MPI_CHAR, source, MPI_ANY_TAG, comm, &request);
+        MPI_Start(&request);
+        active = true;
+    }
+
+    PersistentReceive(const PersistentReceive &) = delete;
+
+    PersistentReceive &operator=(const PersistentReceive &) = delete;
+
+    // true if message was received, status holds its source, tag and length
+    bool test(MPI_Status &status) {
+        CommTimer timer;
+        int flag;
+        MPI_Test(&request, &flag, &status);
+        if (flag) {
+            active = false;
+            traceReceived(status);
+        }
+        return flag;
+    }
+
+    void wait(MPI_Status &status) {
+        CommTimer timer;
+        MPI_Wait(&request, &status);
+        active = false;
+        traceReceived(status);
+    }
+
+    void restart() {
+        CommTimer timer;
+        MPI_Start(&request);
+        active = true;
+    }
+
+    char *data() {
+        return buf;
+    }
+
+    ~PersistentReceive() {
+        if (active) {
+            MPI_Cancel(&request);
+            MPI_Wait(&request, MPI_STATUS_IGNORE);
+        }
+        MPI_Request_free(&request);
+        MPI_Free_mem(buf);
+    }
+};
+
+/**
+ * Binary instance file (pack) mapped to memory, written by tools/saj2bin.py, all numbers little-endian.
+ * Header: magic "SAJB", version, instance count, reserved (uint32 each), record offsets (uint64 * count).
+ * Record: rowLen, maxDepth, horse square, bishop square (uint32 each), pawn bitset (uint64 * ceil(rowLen^2 / 64)),
+ * square of (row, col) is row * rowLen + col.
+ * Packs stay mapped until the process exits, processes on one node share the mapped pages.
+ */
+class InstancePack {
+public:
+    static const uint32_t VERSION = 1;
+    static const size_t HEADER_LEN = 16;
+
+    struct Record {
+        uint32_t rowLen;
+        uint32_t maxDepth;
+        uint32_t horse;
+        uint32_t bishop;
+
+        bool hasPawn(int square) const {
+            const uint64_t *pawns = reinterpret_cast<const uint64_t *>(this + 1);
+            return (pawns[square / 64] >> (square % 64)) & 1;
+        }
+    };
+
+private:
+    string path;
+    const char *data;
+    size_t len;
+
+    InstancePack(const string &path, const char *data, size_t len) : path(path), data(data), len(len) {}
+
+    [[noreturn]] void fail(const string &message) const {
+        cerr << path << ": " << message << endl;
+        exit(1);
+    }
+
+public:
+    // nullptr if path is not a pack, packs are cached by path, exits on unknown version or truncated header
+    static const InstancePack *open(const string &path) {
+        static map<string, InstancePack *> packs;
+        auto it = packs.find(path);
+        if (it != packs.end()) return it->second;
+
+        InstancePack *pack = nullptr;
+        int fd = ::open(path.c_str(), O_RDONLY);
+        struct stat st;
+        if (fd >= 0 && fstat(fd, &st) == 0 && size_t(st.st_size) >= HEADER_LEN) {
+            void *mapped = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+            if (mapped != MAP_FAILED) {
+                if (memcmp(mapped, "SAJB", 4) == 0) pack = new InstancePack(path, (const char *) mapped, st.st_size);
+                else munmap(mapped, st.st_size);
+            }
+        }
+        if (fd >= 0) close(fd);
+        if (pack) {
+            uint32_t version = reinterpret_cast<const uint32_t *>(pack->data)[1];
+            if (version != VERSION) {
+                pack->fail("neznámá verze balíku " + to_string(version) + ", podporovaná je " + to_string(VERSION));
+            }
+            if (pack->len < HEADER_LEN + 8 * uint64_t(pack->count())) {
+                pack->fail("zkrácený balík, " + to_string(pack->len) + " bajtů nestačí na hlavičku s " +
+                           to_string(pack->count()) + " instancemi");
+            }
+        }
+        packs[path] = pack;
+        return pack;
+    }
+
+    uint32_t count() const {
+        return reinterpret_cast<const uint32_t *>(data)[2];
+    }
+
+    // exits if there is no such instance or its record does not fit in the pack
+    const Record &record(int index) const {
+        if (index < 0 || uint32_t(index) >= count()) {
+            fail("instance " + to_string(index) + " není v balíku s " + to_string(count()) + " instancemi");
+        }
+        uint64_t offset = reinterpret_cast<const uint64_t *>(data + HEADER_LEN)[index];
+        if (offset < HEADER_LEN + 8 * uint64_t(count()) || offset > len || len - offset < sizeof(Record)) {
+            fail("záznam instance " + to_string(index) + " na pozici " + to_string(offset) + " je mimo balík");
+        }
+        const Record &rec = *reinterpret_cast<const Record *>(data + offset);
+        uint64_t squares = uint64_t(rec.rowLen) * rec.rowLen;
+        if (len - offset - sizeof(Record) < 8 * ((squares + 63) / 64)) {
+            fail("záznam instance " + to_string(index) + " přesahuje konec balíku");
+        }
+        if (rec.horse >= squares || rec.bishop >= squares) {
+            fail("kůň nebo střelec instance " + to_string(index) + " je mimo šachovnici");
+        }
+        return rec;
+    }
+};
+
 class ChessBoard {
 private:
-    char *grid = nullptr;
-    int size;
+    char grid[GRID_CAPACITY]; // rows of the side plus both borders, see square
     int rowLen;
     int pawnCnt;
     int minDepth;
@@ -63,60 +629,44 @@ private:
     // PDP hint heuristic
     int maxDepth;
 
+    // index of (row, col) in grid, N as in at<N>
+    template<int N>
+    int square(int row, int col) const {
+        return (row + BOARD_BORDER) * ((N ? N : rowLen) + 2 * BOARD_BORDER) + col + BOARD_BORDER;
+    }
+
+    // grid of EMPTY squares surrounded by BOARD_BORDER squares of INVALID_AT
+    void initGrid() {
+        memset(grid, INVALID_AT, sizeof(grid));
+        for (int row = 0; row < rowLen; row++) memset(grid + square<0>(row, 0), EMPTY, rowLen);
+    }
+
     void setAt(int row, int col, char value) {
-        grid[row * rowLen + col] = value;
+        grid[square<0>(row, col)] = value;
     }
 
     class ChessMove {
     private:
-        int row;
-        int col;
+        unsigned char row;
+        unsigned char col;
         bool tookPawn;
     public:
         ChessMove(int row, int col, bool tookPawn) : row(row), col(col), tookPawn(tookPawn) {}
 
         ChessMove() = default;
 
-        friend ostream &operator<<(ostream &os, const ChessMove &m) {
-            os << m.row << "," << m.col;
-            if (m.tookPawn) os << " *";
-            return os;
+        int getRow() const {
+            return row;
         }
 
-        void serializeToBuffer(char *buf, int bufLen, int &written) {
-            char *head = buf;
-
-            memcpy(head, &row, sizeof(row));
-            head += sizeof(row);
-
-            memcpy(head, &col, sizeof(col));
-            head += sizeof(col);
-
-            short tookPawnShort = tookPawn;
-            memcpy(head, &tookPawnShort, sizeof(tookPawnShort));
-            head += sizeof(tookPawnShort);
-
-            written = head - buf;
+        int getCol() const {
+            return col;
         }
 
-        static ChessMove deserializeFromBuffer(char *buf, int bufLen, int &read) {
-            char *head = buf;
-
-            int row;
-            memcpy(&row, head, sizeof(row));
-            head += sizeof(row);
-
-            int col;
-            memcpy(&col, head, sizeof(col));
-            head += sizeof(col);
-
-            short tookPawnShort;
-            memcpy(&tookPawnShort, head, sizeof(tookPawnShort));
-            bool tookPawn = tookPawnShort;
-            head += sizeof(tookPawnShort);
-
-            read = head - buf;
-            return ChessMove(row, col, tookPawn);
+        friend ostream &operator<<(ostream &os, const ChessMove &m) {
+            os << int(m.row) << "," << int(m.col);
+            if (m.tookPawn) os << " *";
+            return os;
         }
     };
 
@@ -131,37 +681,6 @@ private:
 
         ChessPiece(int row, int col, char type) : row(row), col(col), type(type) {}
 
-        void serializeToBuffer(char *buf, int bufLen, int &written) {
-            char *head = buf;
-
-            memcpy(head, &row, sizeof(row));
-            head += sizeof(row);
-
-            memcpy(head, &col, sizeof(col));
-            head += sizeof(col);
-
-            *(head++) = type;
-
-            written = head - buf;
-        }
-
-        static ChessPiece deserializeFromBuffer(char *buf, int bufLen, int &read) {
-            char *head = buf;
-
-            int row;
-            memcpy(&row, head, sizeof(row));
-            head += sizeof(row);
-
-            int col;
-            memcpy(&col, head, sizeof(col));
-            head += sizeof(col);
-
-            char type = *(head++);
-
-            read = head - buf;
-            return ChessPiece(row, col, type);
-        }
-
         int getRow() const {
             return row;
         }
@@ -186,11 +705,13 @@ private:
 
     ChessPiece bishop;
     ChessPiece horse;
-    vector<ChessMove> moveLog;
+    // moves played from the initial board, stored in the board, so that it is a value without pointers
+    ChessMove moveLog[MAX_DEPTH];
+    int moveCnt = 0;
 
     void logMovePiece(int row, int col) {
         bool tookPawn = at(row, col) == PAWN;
-        moveLog.emplace_back(ChessMove(row, col, tookPawn));
+        moveLog[moveCnt++] = ChessMove(row, col, tookPawn);
     }
 
     void movePiece(ChessPiece &p, int row, int col) {
@@ -202,182 +723,112 @@ private:
         p.setCol(col);
     }
 
-public:
-    ChessBoard(char *grid, int size, int rowLen, int pawnCnt, int minDepth, int maxDepth, const ChessPiece &bishop,
-               const ChessPiece &horse, const vector<ChessMove> &moveLog) : grid(grid), size(size), rowLen(rowLen),
-                                                                            pawnCnt(pawnCnt), minDepth(minDepth),
-                                                                            maxDepth(maxDepth), bishop(bishop),
-                                                                            horse(horse), moveLog(moveLog) {}
+    void loadRecord(const InstancePack::Record &rec) {
+        rowLen = rec.rowLen;
+        maxDepth = rec.maxDepth;
+        pawnCnt = 0;
+        initGrid();
+        for (int i = 0; i < rowLen * rowLen; i++) {
+            if (rec.hasPawn(i)) {
+                setAt(i / rowLen, i % rowLen, PAWN);
+                pawnCnt++;
+            }
+        }
+        horse = ChessPiece(rec.horse / rowLen, rec.horse % rowLen, HORSE);
+        bishop = ChessPiece(rec.bishop / rowLen, rec.bishop % rowLen, BISHOP);
+        setAt(horse.getRow(), horse.getCol(), HORSE);
+        setAt(bishop.getRow(), bishop.getCol(), BISHOP);
+        minDepth = pawnCnt;
+    }
 
 public:
 
     // returned when accessing invalid position in chess board
     const static char INVALID_AT = '\0';
 
+    // grid and move log are stored in the board, larger instances need larger limits at compile time
+    static void checkLimits(int rowLen, int maxDepth, const string &filename) {
+        if (rowLen > MAX_ROW_LEN) {
+            cerr << filename << ": šachovnice " << rowLen << "x" << rowLen << " je větší než podporovaná "
+                 << MAX_ROW_LEN << "x" << MAX_ROW_LEN << ", přeložte s -DMAX_ROW_LEN=" << rowLen << endl;
+            exit(1);
+        }
+        if (maxDepth > MAX_DEPTH) {
+            cerr << filename << ": maximální hloubka " << maxDepth << " je větší než podporovaná " << MAX_DEPTH
+                 << ", přeložte s -DMAX_DEPTH=" << maxDepth << endl;
+            exit(1);
+        }
+    }
+
+    // instance file in text format, or binary pack, "pack#i" is i-th instance of the pack
     ChessBoard(const string &filename) {
+        size_t sep = filename.find_last_of('#');
+        const InstancePack *pack = InstancePack::open(filename.substr(0, sep));
+        if (pack) {
+            const InstancePack::Record &rec = pack->record(sep == string::npos ? 0 : stoi(filename.substr(sep + 1)));
+            checkLimits(rec.rowLen, rec.maxDepth, filename);
+            loadRecord(rec);
+            return;
+        }
+
         ifstream ifs(filename);
         ifs >> rowLen;
         ifs >> maxDepth;
-        size = rowLen * rowLen;
+        checkLimits(rowLen, maxDepth, filename);
         pawnCnt = 0;
-        grid = new char[size];
-        memset(grid, EMPTY, size);
+        initGrid();
 
         char c;
-        char *head = grid;
-        while (ifs.get(c) && head < grid + size) {
+        int idx = 0;
+        while (ifs.get(c) && idx < rowLen * rowLen) {
             if (c != '\n' && c != '\r') {
-                int idx = int(head - grid);
                 int row = int(idx / rowLen);
                 int col = idx % rowLen;
                 if (c == BISHOP) bishop = ChessPiece(row, col, BISHOP);
                 if (c == HORSE) horse = ChessPiece(row, col, HORSE);
                 if (c == PAWN) pawnCnt++;
-                *(head++) = c;
+                setAt(row, col, c);
+                idx++;
             }
         }
         ifs.close();
         minDepth = pawnCnt;
     };
 
-    ChessBoard(const ChessBoard &oth) {
-        grid = new char[oth.size];
-        memcpy(grid, oth.grid, oth.size);
-        size = oth.size;
-        rowLen = oth.rowLen;
-        bishop = oth.bishop;
-        horse = oth.horse;
-        pawnCnt = oth.pawnCnt;
-        minDepth = oth.minDepth;
-        maxDepth = oth.maxDepth;
-        moveLog = oth.moveLog;
-    };
-
-    void serializeToBuffer(char *buf, int bufLen, int &written) {
-        char *head = buf;
-        int cnt;
-
-        memcpy(head, &size, sizeof(size));
-        head += sizeof(size);
-
-        memcpy(head, &rowLen, sizeof(rowLen));
-        head += sizeof(rowLen);
-
-        memcpy(head, &pawnCnt, sizeof(pawnCnt));
-        head += sizeof(pawnCnt);
-
-        memcpy(head, &minDepth, sizeof(minDepth));
-        head += sizeof(minDepth);
-
-        memcpy(head, &maxDepth, sizeof(maxDepth));
-        head += sizeof(maxDepth);
-
-        memcpy(head, grid, size);
-        head += size;
-
-        bishop.serializeToBuffer(head, bufLen - (head - buf), cnt);
-        head += cnt;
-
-        horse.serializeToBuffer(head, bufLen - (head - buf), cnt);
-        head += cnt;
-
-        int moveLogSize = moveLog.size();
-        memcpy(head, &moveLogSize, sizeof(moveLogSize));
-        head += sizeof(moveLogSize);
-
-        for (int i = 0; i < moveLogSize; i++) {
-            moveLog[i].serializeToBuffer(head, bufLen - (head - buf), cnt);
-            head += cnt;
-        }
-
-        written = head - buf;
-    }
+    // plain value, copied (and sent between ranks) byte by byte, see serializeToBuffer
+    ChessBoard() = default;
 
-    static ChessBoard deserializeFromBuffer(char *buf, int bufLen) {
-        int read;
-        return deserializeFromBuffer(buf, bufLen, read);
+    // message holding the board is the board as it is in memory, ranks run the same binary
+    static int serializedSize() {
+        return sizeof(ChessBoard);
     }
 
-    static ChessBoard deserializeFromBuffer(char *buf, int bufLen, int &read) {
-        char *head = buf;
-        int cnt;
-
-        int size;
-        memcpy(&size, head, sizeof(size));
-        head += sizeof(size);
-
-        int rowLen;
-        memcpy(&rowLen, head, sizeof(rowLen));
-        head += sizeof(rowLen);
-
-        int pawnCnt;
-        memcpy(&pawnCnt, head, sizeof(pawnCnt));
-        head += sizeof(pawnCnt);
-
-        int minDepth;
-        memcpy(&minDepth, head, sizeof(minDepth));
-        head += sizeof(minDepth);
-
-        int maxDepth;
-        memcpy(&maxDepth, head, sizeof(maxDepth));
-        head += sizeof(maxDepth);
-
-        char *grid = new char[size];
-        memcpy(grid, head, size);
-        head += size;
-
-        ChessPiece bishop = ChessPiece::deserializeFromBuffer(head, bufLen - (head - buf), cnt);
-        head += cnt;
-        ChessPiece horse = ChessPiece::deserializeFromBuffer(head, bufLen - (head - buf), cnt);
-        head += cnt;
-
-        int moveLogSize;
-        memcpy(&moveLogSize, head, sizeof(moveLogSize));
-        head += sizeof(moveLogSize);
-
-        // TODO remove printing
-        /*
-        cout << "==============================" << endl;
-        cout << "size=" << size << endl;
-        cout << "rowLen=" << rowLen << endl;
-        cout << "panwCnt=" << pawnCnt << endl;
-        cout << "minDepth=" << minDepth << endl;
-        cout << "maxDepth=" << maxDepth << endl;
-        cout << "Bishop=" << bishop.getCol() << "," << bishop.getRow() << ", type=" << bishop.getType() << endl;
-        cout << "Horse=" << horse.getCol() << ", " << horse.getRow() << ", type=" << horse.getType() << endl;
-        cout << "==============================" << endl << endl;
-         */
-
-        vector<ChessMove> moveLog(moveLogSize);
-        for (int i = 0; i < moveLogSize; i++) {
-            moveLog[i] = ChessMove::deserializeFromBuffer(head, bufLen - (head - buf), cnt);
-            head += cnt;
-        }
-
-        read = head - buf;
-        return ChessBoard(grid, size, rowLen, pawnCnt, minDepth, maxDepth, bishop, horse, moveLog);
+    void serializeToBuffer(char *buf, int bufLen, int &written) const {
+        PerfScope perf(PHASE_SERIALIZATION);
+        memcpy(buf, this, sizeof(ChessBoard));
+        written = sizeof(ChessBoard);
     }
 
-    ChessBoard &operator=(const ChessBoard &oth) {
-        memcpy(grid, oth.grid, oth.size);
-        size = oth.size;
-        rowLen = oth.rowLen;
-        bishop = oth.bishop;
-        horse = oth.horse;
-        pawnCnt = oth.pawnCnt;
-        minDepth = oth.minDepth;
-        maxDepth = oth.maxDepth;
-        moveLog = oth.moveLog;
-        return *this;
+    static ChessBoard deserializeFromBuffer(const char *buf, int bufLen) {
+        PerfScope perf(PHASE_SERIALIZATION);
+        ChessBoard board;
+        memcpy(&board, buf, sizeof(ChessBoard));
+        return board;
     }
 
-    ~ChessBoard() {
-        delete[] grid;
-    }
+    // board of side N, or of side rowLen if N is 0, see DISPATCH_ROW_LEN
+    // with MAILBOX_BOARD squares off the board are read unchecked from the border, at most BOARD_BORDER away
+    template<int N>
+    char at(int row, int col) const {
+#ifndef MAILBOX_BOARD
+        const int n = N ? N : rowLen;
+        if (row < 0 || col < 0 || row >= n || col >= n) return INVALID_AT;
+#endif
+        return grid[square<N>(row, col)];
+    };
 
     char at(int row, int col) const {
-        if (row < 0 || col < 0 || row >= rowLen || col >= rowLen) return INVALID_AT;
-        return grid[row * rowLen + col];
+        return at<0>(row, col);
     };
 
     void moveBishop(int row, int col) {
@@ -408,18 +859,34 @@ public:
         return rowLen;
     }
 
-    const vector<ChessMove> &getMoveLog() const {
-        return moveLog;
+    vector<ChessMove> getMoveLog() const {
+        return vector<ChessMove>(moveLog, moveLog + moveCnt);
     }
 
-    friend ostream &operator<<(ostream &os, const ChessBoard &g) {
+    int getMoveCnt() const {
+        return moveCnt;
+    }
+
+    // FNV-1a hash of side length, max depth and grid as hex string, same for text and binary instance file
+    string hash() const {
+        uint64_t h = 14695981039346656037ULL;
+        auto mix = [&h](unsigned char byte) { h = (h ^ byte) * 1099511628211ULL; };
+        for (int shift = 0; shift < 32; shift += 8) mix((unsigned char) (rowLen >> shift));
+        for (int shift = 0; shift < 32; shift += 8) mix((unsigned char) (maxDepth >> shift));
+        for (int i = 0; i < rowLen * rowLen; i++) mix((unsigned char) at(i / rowLen, i % rowLen));
+        char buf[17];
+        snprintf(buf, sizeof(buf), "%016llx", (unsigned long long) h);
+        return buf;
+    }
+
+    friend ostream &operator<<(ostream &os, const ChessBoard &g) {
         os << "Délka strany šachovnice: " << g.rowLen << endl;
         os << "minimální hloubka: " << g.minDepth << ", maximální hloubka: " << g.maxDepth << endl;
         os << "Kůň na (" << g.horse.getRow() << "," << g.horse.getCol() << ")" << endl;
         os << "Střelec na (" << g.bishop.getRow() << "," << g.bishop.getCol() << ")" << endl;
         os << "Počet pěšáků " << g.pawnCnt << endl;
-        for (int i = 0; i < g.size; i++) {
-            os << g.grid[i];
+        for (int i = 0; i < g.rowLen * g.rowLen; i++) {
+            os << g.at(i / g.rowLen, i % g.rowLen);
             if ((i + 1) % g.rowLen) os << " | ";
             else os << endl;
         }
@@ -434,21 +901,37 @@ public:
         if (getPawnCnt() != 0) {
             return numeric_limits<int>::max();
         } else {
-            return moveLog.size();
+            return getMoveCnt();
         }
     }
 };
 
+// frontier vectors, task captures and messages copy boards byte by byte
+static_assert(is_trivially_copyable<ChessBoard>::value, "ChessBoard musí být triviálně kopírovatelná");
+
 struct Instance {
     ChessBoard board;
     int depth;
     char play;
     int bestPathLen;
+    vector<int> resumePath; // position of DFS restored from checkpoint, see DfsProgress
 
     Instance(const ChessBoard &board, int depth, char play, int bestPathLen) : board(board), depth(depth), play(play),
                                                                                bestPathLen(bestPathLen) {}
 
+    int serializedSize() const {
+        return sizeof(depth) + sizeof(bestPathLen) + sizeof(play) + sizeof(int) * (1 + resumePath.size()) +
+               ChessBoard::serializedSize();
+    }
+
+    // upper bound on size of any message exchanged while solving this instance
+    int maxSerializedSize() const {
+        return sizeof(depth) + sizeof(bestPathLen) + sizeof(play) + sizeof(int) * (1 + CHECKPOINT_DEPTH) +
+               ChessBoard::serializedSize();
+    }
+
     void serializeToBuffer(char *buf, int bufLen, int &written) {
+        PerfScope perf(PHASE_SERIALIZATION);
         char *head = buf;
         int cnt;
 
@@ -460,6 +943,12 @@ struct Instance {
 
         *(head++) = play;
 
+        int resumeLen = resumePath.size();
+        memcpy(head, &resumeLen, sizeof(resumeLen));
+        head += sizeof(resumeLen);
+        memcpy(head, resumePath.data(), resumeLen * sizeof(int));
+        head += resumeLen * sizeof(int);
+
         board.serializeToBuffer(head, bufLen - (head - buf), cnt);
         head += cnt;
 
@@ -472,8 +961,8 @@ struct Instance {
     }
 
     static Instance deserializeFromBuffer(char *buf, int bufLen, int &read) {
+        PerfScope perf(PHASE_SERIALIZATION);
         char *head = buf;
-        int cnt;
 
         int depth;
         memcpy(&depth, head, sizeof(depth));
@@ -485,70 +974,89 @@ struct Instance {
 
         char play = *(head++);
 
-        ChessBoard board = ChessBoard::deserializeFromBuffer(head, bufLen - (head - buf), cnt);
-        head += cnt;
+        int resumeLen;
+        memcpy(&resumeLen, head, sizeof(resumeLen));
+        head += sizeof(resumeLen);
+        vector<int> resumePath(resumeLen);
+        memcpy(resumePath.data(), head, resumeLen * sizeof(int));
+        head += resumeLen * sizeof(int);
+
+        ChessBoard board = ChessBoard::deserializeFromBuffer(head, bufLen - (head - buf));
+        head += ChessBoard::serializedSize();
 
         read = head - buf;
-        return Instance(board, depth, play, bestPathLen);
+        Instance ins(board, depth, play, bestPathLen);
+        ins.resumePath = resumePath;
+        return ins;
     }
 };
 
 class EvalPosition {
 public:
+    static int for_horse(const ChessBoard &g, int row, int col) {
+        DISPATCH_ROW_LEN(g, for_horse, g, row, col)
+    }
+
+    static int for_bishop(const ChessBoard &g, int row, int col) {
+        DISPATCH_ROW_LEN(g, for_bishop, g, row, col)
+    }
+
+    template<int N>
     static int for_horse(const ChessBoard &g, int row, int col) {
         // take pawn
-        if (g.at(row, col) == PAWN) return 3;
+        if (g.at<N>(row, col) == PAWN) return 3;
 
         // take pawn next move
         for (const auto &cand : HORSE_CAND) {
-            if (g.at(row + cand[0], col + cand[1]) == PAWN)
+            if (g.at<N>(row + cand[0], col + cand[1]) == PAWN)
                 return 2;
         }
 
         // one square away from pawn
         if (
-                g.at(row + 1, col + 1) == PAWN ||
-                g.at(row + 1, col - 1) == PAWN ||
-                g.at(row + 1, col) == PAWN ||
-                g.at(row - 1, col - 1) == PAWN ||
-                g.at(row - 1, col + 1) == PAWN ||
-                g.at(row - 1, col) == PAWN ||
-                g.at(row, col + 1) == PAWN ||
-                g.at(row, col - 1) == PAWN
+                g.at<N>(row + 1, col + 1) == PAWN ||
+                g.at<N>(row + 1, col - 1) == PAWN ||
+                g.at<N>(row + 1, col) == PAWN ||
+                g.at<N>(row - 1, col - 1) == PAWN ||
+                g.at<N>(row - 1, col + 1) == PAWN ||
+                g.at<N>(row - 1, col) == PAWN ||
+                g.at<N>(row, col + 1) == PAWN ||
+                g.at<N>(row, col - 1) == PAWN
                 )
             return 1;
 
         return 0;
     };
 
+    template<int N>
     static int for_bishop(const ChessBoard &g, int row, int col) {
-        if (g.at(row, col) == PAWN) return 2;
+        if (g.at<N>(row, col) == PAWN) return 2;
         char c;
 
         // DIAG DOWN RIGHT
         for (int i = 1;; i++) {
-            c = g.at(row + i, col + i);
+            c = g.at<N>(row + i, col + i);
             if (c == ChessBoard::INVALID_AT || c == HORSE) break;
             if (c == PAWN) return 1;
         }
 
         // DIAG DOWN LEFT
         for (int i = 1;; i++) {
-            c = g.at(row + i, col - i);
+            c = g.at<N>(row + i, col - i);
             if (c == ChessBoard::INVALID_AT || c == HORSE) break;
             if (c == PAWN) return 1;
         }
 
         // DIAG UP RIGHT
         for (int i = 1;; i++) {
-            c = g.at(row - i, col + i);
+            c = g.at<N>(row - i, col + i);
             if (c == ChessBoard::INVALID_AT || c == HORSE) break;
             if (c == PAWN) return 1;
         }
 
         // DIAG UP LEFT
         for (int i = 1;; i++) {
-            c = g.at(row - i, col - i);
+            c = g.at<N>(row - i, col - i);
             if (c == ChessBoard::INVALID_AT || c == HORSE) break;
             if (c == PAWN) return 1;
         }
@@ -571,86 +1079,165 @@ public:
 
         NextMove(int row, int col, int cost) : row(row), col(col), cost(cost) {}
 
-        static bool add_bishop_if_possible(int row, int col, const ChessBoard &g, vector<NextMove> &moves) {
-            char c = g.at(row, col);
+        template<int N, class Moves>
+        static bool add_bishop_if_possible(int row, int col, const ChessBoard &g, Moves &moves) {
+            char c = g.at<N>(row, col);
             if (c == HORSE || c == ChessBoard::INVALID_AT) {
                 return false;
             }
             if (c == PAWN) {
-                moves.emplace_back(row, col, EvalPosition::for_bishop(g, row, col));
+                moves.add(row, col, EvalPosition::for_bishop<N>(g, row, col));
                 return false;
             }
             if (c == EMPTY) {
-                moves.emplace_back(row, col, EvalPosition::for_bishop(g, row, col));
+                moves.add(row, col, EvalPosition::for_bishop<N>(g, row, col));
                 return true;
             }
             return false;
         }
 
-        static bool add_horse_if_possible(int row, int col, const ChessBoard &g, vector<NextMove> &moves) {
-            char c = g.at(row, col);
+        template<int N, class Moves>
+        static bool add_horse_if_possible(int row, int col, const ChessBoard &g, Moves &moves) {
+            char c = g.at<N>(row, col);
             if (c == EMPTY || c == PAWN) {
-                moves.emplace_back(row, col, EvalPosition::for_horse(g, row, col));
+                moves.add(row, col, EvalPosition::for_horse<N>(g, row, col));
                 return true;
             }
             return false;
         }
 
-        struct comparator {
-            bool operator()(const NextMove &a, const NextMove &b) const {
-                return a.cost > b.cost;
-            }
-        };
+    };
+
+    // moves of one node in a fixed-capacity buffer, generating them does not allocate
+    template<int CAPACITY>
+    class MoveList {
+    private:
+        NextMove items[CAPACITY];
+        int cnt = 0;
+
+    public:
+        void add(int row, int col, int cost) {
+            items[cnt++] = NextMove(row, col, cost);
+        }
+
+        // counting sort on cost, highest first, moves of the same cost keep the order they were generated in
+        void sortByCost() {
+            int start[MAX_MOVE_COST + 2] = {};
+            for (int i = 0; i < cnt; i++) start[MAX_MOVE_COST - items[i].cost + 1]++;
+            for (int c = 1; c <= MAX_MOVE_COST + 1; c++) start[c] += start[c - 1];
+            NextMove sorted[CAPACITY];
+            for (int i = 0; i < cnt; i++) sorted[start[MAX_MOVE_COST - items[i].cost]++] = items[i];
+            copy(sorted, sorted + cnt, items);
+        }
 
+        size_t size() const {
+            return cnt;
+        }
+
+        bool empty() const {
+            return cnt == 0;
+        }
+
+        const NextMove &operator[](size_t i) const {
+            return items[i];
+        }
+
+        const NextMove *begin() const {
+            return items;
+        }
+
+        const NextMove *end() const {
+            return items + cnt;
+        }
     };
 
-    static vector<NextMove> for_horse(const ChessBoard &g) {
+    typedef MoveList<HORSE_MOVE_CAPACITY> HorseMoves;
+    typedef MoveList<BISHOP_MOVE_CAPACITY> BishopMoves;
+
+    static HorseMoves for_horse(const ChessBoard &g) {
+        DISPATCH_ROW_LEN(g, for_horse, g)
+    }
+
+    static BishopMoves for_bishop(const ChessBoard &g) {
+        DISPATCH_ROW_LEN(g, for_bishop, g)
+    }
+
+    template<int N>
+    static HorseMoves for_horse(const ChessBoard &g) {
         int row = g.getHorse().getRow();
         int col = g.getHorse().getCol();
-        vector<NextMove> moves = vector<NextMove>();
-        moves.reserve(8);
+        HorseMoves moves;
         for (const auto &cand : HORSE_CAND) {
-            NextMove::add_horse_if_possible(cand[0] + row, cand[1] + col, g, moves);
+            NextMove::add_horse_if_possible<N>(cand[0] + row, cand[1] + col, g, moves);
         }
 
-        sort(moves.begin(), moves.end(), NextPossibleMoves::NextMove::comparator());
+        moves.sortByCost();
         return moves;
     };
 
-    static vector<NextMove> for_bishop(const ChessBoard &g) {
-        vector<NextMove> moves = vector<NextMove>();
-        moves.reserve(2 * g.getRowLen() - 2);
+    template<int N>
+    static BishopMoves for_bishop(const ChessBoard &g) {
+        BishopMoves moves;
         int row = g.getBishop().getRow();
         int col = g.getBishop().getCol();
 
         // DIAG UP RIGHT
         for (int i = 1;; i++) {
-            if (!NextMove::add_bishop_if_possible(row - i, col + i, g, moves)) break;
+            if (!NextMove::add_bishop_if_possible<N>(row - i, col + i, g, moves)) break;
         }
 
         // DIAG UP LEFT
         for (int i = 1;; i++) {
-            if (!NextMove::add_bishop_if_possible(row - i, col - i, g, moves)) break;
+            if (!NextMove::add_bishop_if_possible<N>(row - i, col - i, g, moves)) break;
         }
 
         // DIAG DOWN RIGHT
         for (int i = 1;; i++) {
-            if (!NextMove::add_bishop_if_possible(row + i, col + i, g, moves)) break;
+            if (!NextMove::add_bishop_if_possible<N>(row + i, col + i, g, moves)) break;
         }
 
         // DIAG DOWN LEFT
         for (int i = 1;; i++) {
-            if (!NextMove::add_bishop_if_possible(row + i, col - i, g, moves)) break;
+            if (!NextMove::add_bishop_if_possible<N>(row + i, col - i, g, moves)) break;
         }
 
-        sort(moves.begin(), moves.end(), NextPossibleMoves::NextMove::comparator());
+        moves.sortByCost();
         return moves;
     };
 
 };
 
+struct BishopPlay;
+
+// side to move as a type, the search is instantiated for each side and alternates them at compile time
+struct HorsePlay {
+    typedef BishopPlay Next;
+    static const char PIECE = HORSE;
+
+    static NextPossibleMoves::HorseMoves moves(const ChessBoard &g) {
+        return NextPossibleMoves::for_horse(g);
+    }
+
+    static void move(ChessBoard &g, int row, int col) {
+        g.moveHorse(row, col);
+    }
+};
+
+struct BishopPlay {
+    typedef HorsePlay Next;
+    static const char PIECE = BISHOP;
+
+    static NextPossibleMoves::BishopMoves moves(const ChessBoard &g) {
+        return NextPossibleMoves::for_bishop(g);
+    }
+
+    static void move(ChessBoard &g, int row, int col) {
+        g.moveBishop(row, col);
+    }
+};
+
 // return true if there is better board available
-bool betterBoardExists(Instance *ins, long bestPathLen) {
+bool betterBoardExists(const Instance *ins, long bestPathLen) {
     return
             ins->depth + ins->board.getPawnCnt() >= bestPathLen || // solution with lower cost already exists
             ins->depth + ins->board.getPawnCnt() > ins->board.getMaxDepth() ||
@@ -658,36 +1245,451 @@ bool betterBoardExists(Instance *ins, long bestPathLen) {
             bestPathLen == ins->board.getMinDepth(); // optimum was reached
 }
 
-void bbDfsSeq(Instance *ins, ChessBoard &bestBoard, long &bestPathLen, long &counter) {
+/**
+ * Machine-readable summary of a run for the analysis pipeline, see --report.
+ * Appended to the report file as one JSON object per line, or as one CSV row if the file name ends with .csv
+ * (with header when the file is empty). Fields keep the order in which they were added.
+ */
+class RunReport {
+private:
+    vector<string> names;
+    vector<string> jsonValues;
+    vector<string> csvValues;
+
+    static string jsonQuote(const string &s) {
+        string quoted = "\"";
+        for (char c : s) {
+            if (c == '"' || c == '\\') quoted += '\\';
+            quoted += c;
+        }
+        return quoted + "\"";
+    }
+
+    static string csvQuote(const string &s) {
+        string quoted = "\"";
+        for (char c : s) {
+            if (c == '"') quoted += '"';
+            quoted += c;
+        }
+        return quoted + "\"";
+    }
+
+    void add(const string &name, const string &jsonValue, const string &csvValue) {
+        names.push_back(name);
+        jsonValues.push_back(jsonValue);
+        csvValues.push_back(csvValue);
+    }
+
+public:
+    void addCount(const string &name, long value) {
+        add(name, to_string(value), to_string(value));
+    }
+
+    // real value with 3 decimal places, times are in milliseconds
+    void addTime(const string &name, double value) {
+        char buf[32];
+        snprintf(buf, sizeof(buf), "%.3f", value);
+        add(name, buf, buf);
+    }
+
+    void addText(const string &name, const string &value) {
+        add(name, jsonQuote(value), csvQuote(value));
+    }
+
+    // items as printed by operator<<, JSON array of strings, in CSV joined by ';'
+    template<class T>
+    void addList(const string &name, const vector<T> &items) {
+        string json = "[", csv;
+        for (size_t i = 0; i < items.size(); i++) {
+            ostringstream item;
+            item << items[i];
+            json += (i ? ", " : "") + jsonQuote(item.str());
+            csv += (i ? ";" : "") + item.str();
+        }
+        add(name, json + "]", csvQuote(csv));
+    }
+
+    // JSON array of numbers, in CSV joined by ';'
+    void addCountList(const string &name, const vector<long> &values) {
+        string json = "[", csv;
+        for (size_t i = 0; i < values.size(); i++) {
+            json += (i ? ", " : "") + to_string(values[i]);
+            csv += (i ? ";" : "") + to_string(values[i]);
+        }
+        add(name, json + "]", csvQuote(csv));
+    }
+
+    void append(const string &path) const {
+        bool csv = path.size() > 4 && path.compare(path.size() - 4, 4, ".csv") == 0;
+        ifstream existing(path);
+        bool empty = existing.peek() == ifstream::traits_type::eof();
+        existing.close();
+
+        ofstream os(path, ios::app);
+        if (csv) {
+            if (empty) {
+                for (size_t i = 0; i < names.size(); i++) os << (i ? "," : "") << names[i];
+                os << endl;
+            }
+            for (size_t i = 0; i < csvValues.size(); i++) os << (i ? "," : "") << csvValues[i];
+            os << endl;
+        } else {
+            os << "{";
+            for (size_t i = 0; i < names.size(); i++) {
+                os << (i ? ", " : "") << jsonQuote(names[i]) << ": " << jsonValues[i];
+            }
+            os << "}" << endl;
+        }
+        if (!os) cerr << "Report se nepodařilo zapsat do " << path << endl;
+    }
+};
+
+#ifdef PROFILE_TREE
+#define PROFILE(statement) statement
+#define PROFILE_MAX_DEPTH 128 // deeper nodes are counted in the last level of the profile
+#else
+#define PROFILE(statement)
+#endif
+
+/**
+ * Counters of the search of one process, shared by its search threads.
+ * Pruned nodes are split by the first condition of betterBoardExists that cut them off.
+ * Profiling build (-DPROFILE_TREE) keeps the counters also per depth of the search tree, see printProfile.
+ */
+struct SearchStats {
+    long nodes = 0;
+    long prunedBound = 0;
+    long prunedMaxDepth = 0;
+    long prunedOptimum = 0;
+#ifdef PROFILE_TREE
+    struct Level {
+        long entered = 0;
+        long expanded = 0; // nodes whose moves were generated
+        long children = 0;
+        long prunedBound = 0;
+        long prunedMaxDepth = 0;
+        long prunedOptimum = 0;
+        long solutions = 0; // leaves without pawns, improving the best solution or not
+    };
+    Level levels[PROFILE_MAX_DEPTH];
+
+    Level &level(long depth) {
+        return levels[min(depth, long(PROFILE_MAX_DEPTH - 1))];
+    }
+
+    static string branching(long children, long expanded) {
+        char buf[32];
+        snprintf(buf, sizeof(buf), "%.2f", expanded ? double(children) / expanded : 0.0);
+        return buf;
+    }
+
+    // one row per depth, play is the piece moved from nodes of that depth (bishop moves first),
+    // levels expanded while generating the initial frontier are not searched by the kernel and stay empty
+    static void printLevels(ostream &os, const Level *levels) {
+        os << "Profil stromu prohledávání" << endl;
+        os << "Hloubka\tTah\tUzly\tRozvinuto\tVětvení\tOřez mez\tOřez maxDepth\tOřez optimum\tŘešení" << endl;
+        long expanded[2] = {0, 0}, children[2] = {0, 0}; // bishop, horse plies
+        for (int d = 0; d < PROFILE_MAX_DEPTH; d++) {
+            const Level &l = levels[d];
+            if (l.entered == 0) continue;
+            expanded[d % 2] += l.expanded;
+            children[d % 2] += l.children;
+            os << d << "\t" << (d % 2 ? HORSE : BISHOP) << "\t" << l.entered << "\t" << l.expanded << "\t\t"
+               << branching(l.children, l.expanded) << "\t" << l.prunedBound << "\t\t" << l.prunedMaxDepth
+               << "\t\t" << l.prunedOptimum << "\t\t" << l.solutions << endl;
+        }
+        os << "Průměrné větvení: " << BISHOP << " " << branching(children[0], expanded[0]) << ", " << HORSE << " "
+           << branching(children[1], expanded[1]) << endl << endl;
+    }
+
+    // columns of the profile as lists indexed by depth, up to the deepest level entered
+    static void addLevelsTo(RunReport &report, const Level *levels) {
+        int depths = PROFILE_MAX_DEPTH;
+        while (depths > 0 && levels[depths - 1].entered == 0) depths--;
+        const pair<const char *, long Level::*> columns[] = {
+                {"depth_nodes", &Level::entered},
+                {"depth_expanded", &Level::expanded},
+                {"depth_children", &Level::children},
+                {"depth_pruned_bound", &Level::prunedBound},
+                {"depth_pruned_max_depth", &Level::prunedMaxDepth},
+                {"depth_pruned_optimum", &Level::prunedOptimum},
+                {"depth_solutions", &Level::solutions},
+        };
+        for (const auto &column : columns) {
+            vector<long> values;
+            for (int d = 0; d < depths; d++) values.push_back(levels[d].*column.second);
+            report.addCountList(column.first, values);
+        }
+    }
+#endif
+
+    static void add(long &counter, long n = 1) {
+#pragma omp atomic update
+        counter += n;
+    }
+
+    void entered(long depth) {
+        PROFILE(add(level(depth).entered));
+    }
+
+    void expanded(long depth, long children) {
+        PROFILE(add(level(depth).expanded));
+        PROFILE(add(level(depth).children, children));
+    }
+
+    void solved(long depth) {
+        PROFILE(add(level(depth).solutions));
+    }
+
+    void pruned(const Instance *ins, long bestPathLen) {
+        if (ins->depth + ins->board.getPawnCnt() >= bestPathLen) {
+            add(prunedBound);
+            PROFILE(add(level(ins->depth).prunedBound));
+        } else if (ins->depth + ins->board.getPawnCnt() > ins->board.getMaxDepth()) {
+            add(prunedMaxDepth);
+            PROFILE(add(level(ins->depth).prunedMaxDepth));
+        } else {
+            add(prunedOptimum);
+            PROFILE(add(level(ins->depth).prunedOptimum));
+        }
+    }
+
+    // collective, counters summed over all processes are added on rank 0
+    void reduceTo(RunReport &report, int myRank) const {
+        long local[4] = {nodes, prunedBound, prunedMaxDepth, prunedOptimum};
+        long total[4];
+        MPI_Reduce(local, total, 4, MPI_LONG, MPI_SUM, 0, MPI_COMM_WORLD);
+        if (myRank == 0) {
+            report.addCount("nodes", total[0]);
+            report.addCount("pruned_bound", total[1]);
+            report.addCount("pruned_max_depth", total[2]);
+            report.addCount("pruned_optimum", total[3]);
+        }
+#ifdef PROFILE_TREE
+        Level levelsTotal[PROFILE_MAX_DEPTH];
+        MPI_Reduce(levels, levelsTotal, PROFILE_MAX_DEPTH * sizeof(Level) / sizeof(long), MPI_LONG, MPI_SUM, 0, MPI_COMM_WORLD);
+        if (myRank == 0) addLevelsTo(report, levelsTotal);
+#endif
+    }
+
+    // collective, profile summed over all processes is printed by rank 0, nothing unless built with -DPROFILE_TREE
+    void printProfile(int myRank) const {
+#ifdef PROFILE_TREE
+        Level levelsTotal[PROFILE_MAX_DEPTH];
+        MPI_Reduce(levels, levelsTotal, PROFILE_MAX_DEPTH * sizeof(Level) / sizeof(long), MPI_LONG, MPI_SUM, 0, MPI_COMM_WORLD);
+        if (myRank == 0) printLevels(cout, levelsTotal);
+#endif
+    }
+};
+
+#define NO_TIME_LIMIT 0
+
+/**
+ * Anytime mode, search stops at wall-clock deadline.
+ * Every node reads the clock, so no node is expanded and no improvement is streamed after the deadline,
+ * however the threads are scheduled. Nodes left unexplored because of the deadline keep the lowest lower bound
+ * (depth + pawn count) among them, over all processes it is the lower bound on the optimum.
+ */
+class Deadline {
+private:
+    int myRank;
+    chrono::steady_clock::time_point start;
+    chrono::steady_clock::time_point end;
+    double limit; // [s]
+    mutable atomic<bool> expired;
+    atomic<bool> finished;
+    long openBound;
+
+public:
+    Deadline(double limit, int myRank) : myRank(myRank), start(chrono::steady_clock::now()), limit(limit),
+                                         expired(false), finished(false), openBound(numeric_limits<long>::max()) {
+        end = start + chrono::duration_cast<chrono::steady_clock::duration>(chrono::duration<double>(limit));
+    }
+
+    Deadline(const Deadline &) = delete;
+
+    Deadline &operator=(const Deadline &) = delete;
+
+    // once expired stays expired, after finish the search is not cut any more
+    bool isExpired() const {
+        if (expired.load(memory_order_relaxed)) return true;
+        if (limit == NO_TIME_LIMIT || finished.load(memory_order_relaxed)) return false;
+        if (chrono::steady_clock::now() < end) return false;
+        expired = true;
+        return true;
+    }
+
+    void leaveOpen(long bound) {
+#pragma omp critical(openBound)
+        openBound = min(openBound, bound);
+    }
+
+    // called from the critical section updating bestPathLen, streams time-to-quality in anytime mode
+    void improved(long pathLen) {
+        if (limit == NO_TIME_LIMIT || isExpired()) return;
+        cout << myRank << ": Zlepšení: cena " << pathLen << " po "
+             << chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - start).count() << " ms"
+             << endl;
+    }
+
+    void finish() {
+        finished = true;
+    }
+
+    // collective, master prints lower bound on the optimum and optimality gap of its bestPathLen
+    void report(long bestPathLen) {
+        int expiredLocal = isExpired(), expiredAny;
+        long open;
+        MPI_Reduce(&expiredLocal, &expiredAny, 1, MPI_INT, MPI_MAX, 0, MPI_COMM_WORLD);
+        MPI_Reduce(&openBound, &open, 1, MPI_LONG, MPI_MIN, 0, MPI_COMM_WORLD);
+        if (myRank != 0 || !expiredAny) return;
+
+        long lower = min(bestPathLen, open);
+        cout << "Časový limit " << limit << " s vypršel" << endl;
+        cout << "Dolní mez ceny: " << lower << endl;
+        if (bestPathLen == numeric_limits<int>::max()) {
+            cout << "Mezera optimality: řešení nenalezeno" << endl;
+        } else {
+            printf("Mezera optimality: %ld (%.1f %%)\n", bestPathLen - lower, 100.0 * (bestPathLen - lower) / bestPathLen);
+            fflush(stdout);
+        }
+    }
+};
+
+// moves of board in checkpoint format "count row col row col ..."
+string checkpointMoves(const ChessBoard &board) {
+    ostringstream os;
+    os << board.getMoveLog().size();
+    for (const auto &m : board.getMoveLog()) {
+        os << " " << m.getRow() << " " << m.getCol();
+    }
+    return os.str();
+}
+
+// replays moves in checkpoint format on initial board, bishop plays first
+// nullptr if there are more moves than max depth of the instance or a move is off the board
+Instance *checkpointReplay(const ChessBoard &initBoard, istream &is) {
+    ChessBoard board(initBoard);
+    int cnt = -1, row, col;
+    is >> cnt;
+    if (cnt < 0 || cnt > initBoard.getMaxDepth()) return nullptr;
+    for (int i = 0; i < cnt; i++) {
+        if (!(is >> row >> col) || row < 0 || col < 0 || row >= initBoard.getRowLen() ||
+            col >= initBoard.getRowLen()) {
+            return nullptr;
+        }
+        if (i % 2 == 0) board.moveBishop(row, col);
+        else board.moveHorse(row, col);
+    }
+    return new Instance(board, cnt, cnt % 2 ? HORSE : BISHOP, numeric_limits<int>::max());
+}
+
+// line of checkpoint file describing unfinished instance and where its DFS resumes
+void writeCheckpointInstance(ostream &os, const string &moves, const int *resumePath, int resumeLen) {
+    os << "instance " << moves << " " << resumeLen;
+    for (int i = 0; i < resumeLen; i++) os << " " << resumePath[i];
+    os << endl;
+}
+
+/**
+ * Position of DFS inside of its root instance, index of child searched at each of first CHECKPOINT_DEPTH levels.
+ * Search resumed from this position repeats only the subtrees below CHECKPOINT_DEPTH.
+ */
+struct DfsProgress {
+    omp_lock_t lock;
+    string root; // moves of root instance, empty if idle
+    int path[CHECKPOINT_DEPTH];
+    int pathLen = 0;
+
+    DfsProgress() {
+        omp_init_lock(&lock);
+    }
+
+    ~DfsProgress() {
+        omp_destroy_lock(&lock);
+    }
+
+    void start(const Instance &ins) {
+        omp_set_lock(&lock);
+        root = checkpointMoves(ins.board);
+        pathLen = min(int(ins.resumePath.size()), CHECKPOINT_DEPTH);
+        copy(ins.resumePath.begin(), ins.resumePath.begin() + pathLen, path);
+        omp_unset_lock(&lock);
+    }
+
+    void enter(int level, int child) {
+        if (level >= CHECKPOINT_DEPTH) return;
+        omp_set_lock(&lock);
+        path[level] = child;
+        pathLen = level + 1;
+        omp_unset_lock(&lock);
+    }
+
+    void finish() {
+        omp_set_lock(&lock);
+        root.clear();
+        pathLen = 0;
+        omp_unset_lock(&lock);
+    }
+
+    void writeTo(ostream &os) {
+        omp_set_lock(&lock);
+        if (!root.empty()) writeCheckpointInstance(os, root, path, pathLen);
+        omp_unset_lock(&lock);
+    }
+};
+
+// resume is position of DFS restored from checkpoint, children before it were already searched,
+// Play is the side to move of ins
+template<class Play>
+void bbDfsSeq(Instance *ins, ChessBoard &bestBoard, long &bestPathLen, SearchStats &stats, Deadline &deadline,
+              DfsProgress *progress, int level, const int *resume, int resumeLen) {
+    stats.entered(ins->depth);
     if (!betterBoardExists(ins, bestPathLen)) {
-        if (ins->board.getPawnCnt() == 0) {
+        if (deadline.isExpired()) {
+            deadline.leaveOpen(ins->depth + ins->board.getPawnCnt());
+        } else if (ins->board.getPawnCnt() == 0) {
+            stats.solved(ins->depth);
 #pragma omp critical
             {
                 if (!betterBoardExists(ins, bestPathLen)) {
                     bestPathLen = ins->depth;
                     bestBoard = ins->board;
+                    deadline.improved(bestPathLen);
+                    tracer.instant("incumbent", "cost", bestPathLen);
                 }
             }
-        } else if (ins->play == HORSE) {
-            for (const auto &m : NextPossibleMoves::for_horse(ins->board)) {
-                ChessBoard cpy(ins->board);
-                cpy.moveHorse(m.row, m.col);
-                bbDfsSeq(new Instance(cpy, ins->depth + 1, BISHOP, bestPathLen), bestBoard, bestPathLen, counter);
-            }
-        } else if (ins->play == BISHOP) {
-            for (const auto &m : NextPossibleMoves::for_bishop(ins->board)) {
-                ChessBoard cpy(ins->board);
-                cpy.moveBishop(m.row, m.col);
-                bbDfsSeq(new Instance(cpy, ins->depth + 1, HORSE, bestPathLen), bestBoard, bestPathLen, counter);
+        } else {
+            auto moves = Play::moves(ins->board);
+            stats.expanded(ins->depth, moves.size());
+            for (int i = resumeLen ? resume[0] : 0; i < int(moves.size()); i++) {
+                if (progress) progress->enter(level, i);
+                bool resumed = resumeLen && i == resume[0];
+                Instance child(ins->board, ins->depth + 1, Play::Next::PIECE, bestPathLen);
+                Play::move(child.board, moves[i].row, moves[i].col);
+                bbDfsSeq<typename Play::Next>(&child, bestBoard, bestPathLen, stats, deadline, progress, level + 1,
+                                              resumed ? resume + 1 : nullptr, resumed ? resumeLen - 1 : 0);
             }
         }
+    } else {
+        stats.pruned(ins, bestPathLen);
     }
-    delete ins;
 #pragma omp atomic update
-    counter++;
+    stats.nodes++;
+}
+
+// search of an instance whose side to move is known only at run time
+void bbDfsSeq(Instance *ins, ChessBoard &bestBoard, long &bestPathLen, SearchStats &stats, Deadline &deadline,
+              DfsProgress *progress = nullptr, int level = 0, const int *resume = nullptr, int resumeLen = 0) {
+    if (ins->play == HORSE) {
+        bbDfsSeq<HorsePlay>(ins, bestBoard, bestPathLen, stats, deadline, progress, level, resume, resumeLen);
+    } else {
+        bbDfsSeq<BishopPlay>(ins, bestBoard, bestPathLen, stats, deadline, progress, level, resume, resumeLen);
+    }
 }
 
 vector<Instance *> generateInstancesFrom(const Instance &initInstance, ChessBoard **earlySolution) {
+    PerfScope perf(PHASE_FRONTIER);
     vector<Instance *> instances = vector<Instance *>();
     instances.emplace_back(new Instance(initInstance));
     *earlySolution = nullptr; // in case solution is found during generating instances
@@ -716,108 +1718,1185 @@ vector<Instance *> generateInstancesFrom(const Instance &initInstance, ChessBoar
                 }
             }
         }
+        for (const auto &ins : instances) delete ins;
         instances = instancesNext;
     }
     return instances;
 }
 
-ChessBoard bbDfsDataPar(const Instance &startInstance, long &bestPathLen, long &counter) {
-    ChessBoard *earlySolution = nullptr;
-    vector<Instance *> instances = generateInstancesFrom(startInstance, &earlySolution);
-    if (!earlySolution) {
-        ChessBoard bestBoard(startInstance.board);
-		omp_set_num_threads({PROCNUM}); // CHANGE
-#pragma omp parallel for shared(instances, bestBoard, bestPathLen, counter) schedule(dynamic) default(none)
-        for (unsigned long i = 0; i < instances.size(); i++) {
-            bbDfsSeq(instances[i], bestBoard, bestPathLen, counter);
-        }
-        return bestBoard;
+// how the global bestPathLen gets to slaves
+enum IncumbentMode {
+    INCUMBENT_MSG = 0, // only through master, with each WORK message
+    INCUMBENT_RMA = 1 // also through one-sided RMA window on master, see IncumbentWindow
+};
+
+// period [s] of synchronizing local bestPathLen with the RMA window
+#define INCUMBENT_SYNC_PERIOD 0.001
+
+/**
+ * Global bestPathLen kept in MPI-3 RMA window on rank 0.
+ * Every rank lowers it with MPI_Fetch_and_op(MPI_MIN) and reads it with MPI_Get, both under passive target locking,
+ * so no involvement of master is needed. Creation and destruction are collective.
+ */
+class IncumbentWindow {
+private:
+    MPI_Win win;
+    int *base = nullptr;
+    int published; // lowest value this rank has written to the window
+    double lastSync;
+
+public:
+    explicit IncumbentWindow(int myRank) : published(numeric_limits<int>::max()), lastSync(0) {
+        MPI_Win_allocate(myRank == 0 ? sizeof(int) : 0, sizeof(int), MPI_INFO_NULL, MPI_COMM_WORLD, &base, &win);
+        if (myRank == 0) *base = numeric_limits<int>::max();
+        MPI_Barrier(MPI_COMM_WORLD); // window is initialized before anyone accesses it
+    }
+
+    IncumbentWindow(const IncumbentWindow &) = delete;
+
+    IncumbentWindow &operator=(const IncumbentWindow &) = delete;
+
+    // lowers global bestPathLen to pathLen, returns global bestPathLen after the update
+    int update(int pathLen) {
+        CommTimer timer;
+        int old;
+        MPI_Win_lock(MPI_LOCK_SHARED, 0, 0, win);
+        MPI_Fetch_and_op(&pathLen, &old, MPI_INT, 0, 0, MPI_MIN, win);
+        MPI_Win_unlock(0, win);
+        published = min(published, pathLen);
+        return min(old, pathLen);
+    }
+
+    int read() {
+        CommTimer timer;
+        int value;
+        // MPI_Get would not be atomic with MPI_Fetch_and_op of the other ranks
+        MPI_Win_lock(MPI_LOCK_SHARED, 0, 0, win);
+        MPI_Fetch_and_op(nullptr, &value, MPI_INT, 0, 0, MPI_NO_OP, win);
+        MPI_Win_unlock(0, win);
+        return value;
+    }
+
+    // publishes local bestPathLen if it improved & returns the global one, at most once per INCUMBENT_SYNC_PERIOD
+    int sync(long localPathLen) {
+        double now = MPI_Wtime();
+        if (now - lastSync < INCUMBENT_SYNC_PERIOD) return numeric_limits<int>::max();
+        lastSync = now;
+        if (localPathLen < published) return update(int(localPathLen));
+        return read();
+    }
+
+    ~IncumbentWindow() {
+        MPI_Win_free(&win);
+    }
+};
+
+/**
+ * Rank-local queue of instances shared by a persistent team of search threads.
+ * Instances pushed to the queue are split into EPOCH_CNT deeper levels, so the threads balance the load among
+ * themselves while the feeder thread keeps refilling the queue.
+ */
+struct LocalQueue {
+    deque<Instance *> instances;
+    ChessBoard bestBoard;
+    long bestPathLen;
+    SearchStats stats;
+    double busyTime; // summed over all search threads
+    bool closed; // no more instances will be pushed
+    bool finished; // worker pool has terminated
+    bool checkpointing; // search threads track their DfsProgress
+    vector<DfsProgress> progress; // indexed by thread number in the worker pool
+    Deadline &deadline;
+
+    LocalQueue(const ChessBoard &board, Deadline &deadline) : bestBoard(board),
+                                                              bestPathLen(numeric_limits<int>::max()),
+                                                              busyTime(0), closed(false), finished(false),
+                                                              checkpointing(false), progress({PROCNUM} + 1),
+                                                              deadline(deadline) {}
+
+    void push(const Instance &ins) {
+        if (deadline.isExpired()) { // instance is not searched any more, it only lowers the open bound
+            if (!betterBoardExists(&ins, bestPathLen)) deadline.leaveOpen(ins.depth + ins.board.getPawnCnt());
+            return;
+        }
+        if (!ins.resumePath.empty()) { // DFS restored from checkpoint continues as it was
+#pragma omp critical(localQueue)
+            instances.push_back(new Instance(ins));
+            return;
+        }
+        ChessBoard *earlySolution = nullptr;
+        vector<Instance *> generated = generateInstancesFrom(ins, &earlySolution);
+        if (earlySolution) {
+            offerBoard(*earlySolution);
+            delete earlySolution;
+        }
+#pragma omp critical(localQueue)
+        instances.insert(instances.end(), generated.begin(), generated.end());
+    }
+
+    // instance is taken from queue and registered in progress of calling thread atomically, see snapshot
+    Instance *pop() {
+        Instance *ins = nullptr;
+#pragma omp critical(localQueue)
+        {
+            if (!instances.empty()) {
+                ins = instances.front();
+                instances.pop_front();
+                if (checkpointing) progress[omp_get_thread_num()].start(*ins);
+            }
+        }
+        return ins;
+    }
+
+    // unfinished instances of this queue and its best board in checkpoint format
+    void snapshot(ostream &os) {
+#pragma omp critical(localQueue)
+        {
+            for (const auto &ins : instances) {
+                writeCheckpointInstance(os, checkpointMoves(ins->board), ins->resumePath.data(),
+                                        ins->resumePath.size());
+            }
+            for (auto &p : progress) p.writeTo(os);
+        }
+        // best board is read after the instances, so solution of any instance finished meanwhile is in it
+#pragma omp critical
+        os << "best " << bestBoard.getPathLen() << " " << checkpointMoves(bestBoard) << endl;
+    }
+
+    size_t size() {
+        size_t s;
+#pragma omp critical(localQueue)
+        s = instances.size();
+        return s;
+    }
+
+    void close() {
+#pragma omp critical(localQueue)
+        closed = true;
+    }
+
+    bool isClosed() {
+        bool c;
+#pragma omp critical(localQueue)
+        c = closed;
+        return c;
+    }
+
+    bool isFinished() {
+        bool f;
+#pragma omp critical(localQueue)
+        f = finished;
+        return f;
+    }
+
+    // same critical section as in bbDfsSeq
+    void offerBoard(const ChessBoard &board) {
+#pragma omp critical
+        {
+            if (board.getPathLen() < bestPathLen) {
+                bestBoard = board;
+                bestPathLen = board.getPathLen();
+            }
+        }
+    }
+
+    void offerBestPathLen(long pathLen) {
+#pragma omp critical
+        {
+            if (pathLen < bestPathLen) bestPathLen = pathLen;
+        }
+    }
+
+    void serializeBestBoard(char *buf, int bufLen, int &written) {
+#pragma omp critical
+        bestBoard.serializeToBuffer(buf, bufLen, written);
+    }
+};
+
+// refill local queue when it holds fewer instances than this
+#define QUEUE_WATERMARK (2 * {PROCNUM})
+
+/**
+ * Runs searchThreadCnt search threads on the queue and one feeder thread (thread 0 of the team).
+ * The feeder is called repeatedly until it returns false, it is responsible for closing the queue.
+ * Thread 0 of the team is the calling thread, so the feeder may call MPI under MPI_THREAD_FUNNELED.
+ */
+template<class Feeder>
+void runWorkerPool(LocalQueue &queue, int searchThreadCnt, Feeder feed) {
+#pragma omp parallel num_threads(searchThreadCnt + 1) shared(queue, feed, tracer) default(none)
+    {
+        if (omp_get_thread_num() == 0) {
+            while (feed(queue));
+        } else {
+            int64_t idleStart = -1; // waiting for an instance since, in trace time
+            while (true) {
+                Instance *ins = queue.pop();
+                if (!ins) {
+                    if (idleStart < 0 && tracer.isStarted()) idleStart = tracer.now();
+                    if (queue.isClosed() && queue.size() == 0) break;
+                    this_thread::sleep_for(chrono::microseconds(100));
+                    continue;
+                }
+                if (idleStart >= 0) tracer.span("idle", idleStart);
+                idleStart = -1;
+                TraceSpan span("instance", "depth", ins->depth);
+                PerfScope perf(PHASE_SEARCH);
+                double tBusy = omp_get_wtime();
+                DfsProgress *progress = queue.checkpointing ? &queue.progress[omp_get_thread_num()] : nullptr;
+                const int *resume = ins->resumePath.data();
+                bbDfsSeq(ins, queue.bestBoard, queue.bestPathLen, queue.stats, queue.deadline, progress, 0, resume,
+                         ins->resumePath.size());
+                if (progress) progress->finish();
+                delete ins;
+                double busy = omp_get_wtime() - tBusy;
+#pragma omp atomic update
+                queue.busyTime += busy;
+            }
+            if (idleStart >= 0) tracer.span("idle", idleStart);
+        }
+    }
+#pragma omp critical(localQueue)
+    queue.finished = true;
+}
+
+// how MPI processes are organized
+enum Topology {
+    TOPOLOGY_FLAT = 0, // master talks to every slave directly
+    TOPOLOGY_HIER = 1 // master talks to one leader per node, leaders share work through NodeQueue
+};
+
+// slots of node queue, number of instances master sends to node leader at once
+#define NODE_QUEUE_CAPACITY 64
+#define NODE_BLOCK_SIZE 16
+
+/**
+ * Queue of serialized instances shared by all processes of one node.
+ * Ring buffer of NODE_QUEUE_CAPACITY slots in MPI-3 shared memory window of the node leader (node rank 0),
+ * every access is done with direct loads/stores under exclusive lock of the window.
+ * Header also holds the best path length known on the node. Creation and destruction are collective over nodeComm.
+ */
+class NodeQueue {
+private:
+    struct Header {
+        int head;
+        int tail;
+        int closed;
+        int bestPathLen;
+    };
+
+    MPI_Win win;
+    char *base = nullptr;
+    int slotLen;
+
+    Header *header() {
+        return (Header *) base;
+    }
+
+    char *slot(int idx) {
+        return base + sizeof(Header) + (idx % NODE_QUEUE_CAPACITY) * slotLen;
+    }
+
+    void lock() {
+        CommTimer timer;
+        MPI_Win_lock(MPI_LOCK_EXCLUSIVE, 0, 0, win);
+        MPI_Win_sync(win);
+    }
+
+    void unlock() {
+        CommTimer timer;
+        MPI_Win_sync(win);
+        MPI_Win_unlock(0, win);
+    }
+
+public:
+    NodeQueue(MPI_Comm nodeComm, int msgCapacity) : slotLen(sizeof(int) + msgCapacity) {
+        int nodeRank;
+        MPI_Comm_rank(nodeComm, &nodeRank);
+        MPI_Aint winSize = nodeRank == 0 ? sizeof(Header) + MPI_Aint(NODE_QUEUE_CAPACITY) * slotLen : 0;
+        MPI_Win_allocate_shared(winSize, 1, MPI_INFO_NULL, nodeComm, &base, &win);
+        if (nodeRank == 0) {
+            *header() = Header{0, 0, 0, numeric_limits<int>::max()};
+        } else {
+            int dispUnit;
+            MPI_Win_shared_query(win, 0, &winSize, &dispUnit, &base);
+        }
+        MPI_Barrier(nodeComm); // header is initialized before anyone accesses it
+    }
+
+    NodeQueue(const NodeQueue &) = delete;
+
+    NodeQueue &operator=(const NodeQueue &) = delete;
+
+    int size() {
+        lock();
+        int s = header()->tail - header()->head;
+        unlock();
+        return s;
+    }
+
+    // returns false if the queue is full
+    bool push(Instance &ins) {
+        lock();
+        bool full = header()->tail - header()->head >= NODE_QUEUE_CAPACITY;
+        if (!full) {
+            char *head = slot(header()->tail);
+            int len;
+            ins.serializeToBuffer(head + sizeof(int), slotLen - sizeof(int), len);
+            memcpy(head, &len, sizeof(len));
+            header()->tail++;
+        }
+        unlock();
+        return !full;
+    }
+
+    // moves one instance to local queue, returns false if there is none, closed tells if there will be none
+    bool popInto(LocalQueue &queue, bool &closed) {
+        Instance *ins = nullptr;
+        lock();
+        if (header()->tail > header()->head) {
+            char *head = slot(header()->head);
+            int len;
+            memcpy(&len, head, sizeof(len));
+            ins = new Instance(Instance::deserializeFromBuffer(head + sizeof(int), len));
+            header()->head++;
+        }
+        closed = header()->closed;
+        unlock();
+
+        if (!ins) return false;
+        queue.push(*ins);
+        delete ins;
+        return true;
+    }
+
+    void close() {
+        lock();
+        header()->closed = 1;
+        unlock();
+    }
+
+    // lowers best path length of the node to pathLen, returns best path length of the node after the update
+    int offerBestPathLen(long pathLen) {
+        lock();
+        if (pathLen < header()->bestPathLen) header()->bestPathLen = int(pathLen);
+        int best = header()->bestPathLen;
+        unlock();
+        return best;
+    }
+
+    ~NodeQueue() {
+        MPI_Win_free(&win);
+    }
+};
+
+/**
+ * Periodic checkpoint of flat topology search, written by master.
+ * Master asks every running slave for its state over a dedicated communicator: number of WORK messages received,
+ * queued instances, DFS positions of its search threads and its best board. Master adds instances it has not handed
+ * out yet, its own local queue and WORK messages sent after the slave's reply. Slaves answer from the feeder thread,
+ * so their search threads are never stopped.
+ *
+ * File format, one record per line:
+ * PDP-CHECKPOINT 2 <hash of the instance>
+ * best <pathLen> <move count> <row> <col> ...
+ * instance <move count> <row> <col> ... <resume path length> <child index> ...
+ */
+class CheckpointWriter {
+private:
+    string path;
+    double period;
+    MPI_Comm comm;
+    double lastRequest;
+    bool collecting = false;
+    vector<char> awaiting;
+    int awaitingCnt = 0;
+    vector<string> replies;
+    const Deadline &deadline;
+    string instanceHash;
+
+public:
+    CheckpointWriter(const string &path, double period, MPI_Comm comm, int processCount, const Deadline &deadline,
+                     const string &instanceHash)
+            : path(path), period(period), comm(comm), lastRequest(MPI_Wtime()), awaiting(processCount, 0),
+              replies(processCount), deadline(deadline), instanceHash(instanceHash) {}
+
+    // asks running slaves for their state once the period since the last checkpoint has elapsed
+    void requestIfDue(const vector<char> &terminated) {
+        if (collecting || MPI_Wtime() - lastRequest < period) return;
+        lastRequest = MPI_Wtime();
+        collecting = true;
+        for (int i = 1; i < int(terminated.size()); i++) {
+            replies[i].clear();
+            if (terminated[i]) continue;
+            MPI_Send(nullptr, 0, MPI_CHAR, i, MessageTag::CHECKPOINT, comm);
+            awaiting[i] = 1;
+            awaitingCnt++;
+        }
+    }
+
+    // receives replies of slaves, returns true when all of them are in and the checkpoint can be written
+    bool poll() {
+        int flag;
+        MPI_Status status;
+        MPI_Iprobe(MPI_ANY_SOURCE, MessageTag::CHECKPOINT, comm, &flag, &status);
+        while (flag) {
+            int len;
+            MPI_Get_count(&status, MPI_CHAR, &len);
+            string reply(len, '\0');
+            MPI_Recv(&reply[0], len, MPI_CHAR, status.MPI_SOURCE, MessageTag::CHECKPOINT, comm, MPI_STATUS_IGNORE);
+            replies[status.MPI_SOURCE] = reply;
+            slaveAnswered(status.MPI_SOURCE);
+            MPI_Iprobe(MPI_ANY_SOURCE, MessageTag::CHECKPOINT, comm, &flag, &status);
+        }
+        if (!collecting || awaitingCnt > 0) return false;
+        collecting = false;
+        return true;
+    }
+
+    // also called for terminated slave, it has no state left and may never answer the request
+    void slaveAnswered(int rank) {
+        if (!awaiting[rank]) return;
+        awaiting[rank] = 0;
+        awaitingCnt--;
+    }
+
+    void write(vector<Instance *> &insList, size_t &insHead, LocalQueue &masterQueue, const ChessBoard &bestBoard,
+               const vector<vector<Instance *>> &sentTo, const vector<char> &terminated) {
+        ostringstream state;
+        state << "best " << bestBoard.getPathLen() << " " << checkpointMoves(bestBoard) << endl;
+#pragma omp critical(masterQueue)
+        {
+            for (size_t i = insHead; i < insList.size(); i++) {
+                writeCheckpointInstance(state, checkpointMoves(insList[i]->board), insList[i]->resumePath.data(),
+                                        insList[i]->resumePath.size());
+            }
+            masterQueue.snapshot(state);
+        }
+        // instances cut by the deadline end as if they were finished, checkpoint is kept as it was before
+        if (deadline.isExpired()) return;
+        for (int i = 1; i < int(replies.size()); i++) {
+            if (terminated[i]) continue;
+            istringstream reply(replies[i]);
+            string tag;
+            size_t received = 0;
+            reply >> tag >> received;
+            if (tag == "expired") return;
+            for (size_t j = received; j < sentTo[i].size(); j++) { // WORK messages the slave has not seen yet
+                writeCheckpointInstance(state, checkpointMoves(sentTo[i][j]->board), sentTo[i][j]->resumePath.data(),
+                                        sentTo[i][j]->resumePath.size());
+            }
+            state << replies[i];
+        }
+
+        // only the best of all best boards is kept
+        istringstream is(state.str());
+        ostringstream instances;
+        string line, best;
+        long bestLen = numeric_limits<long>::max();
+        while (getline(is, line)) {
+            if (line.compare(0, 9, "instance ") == 0) {
+                instances << line << endl;
+            } else if (line.compare(0, 5, "best ") == 0) {
+                long len = stol(line.substr(5));
+                if (best.empty() || len < bestLen) {
+                    best = line;
+                    bestLen = len;
+                }
+            }
+        }
+
+        ofstream ofs(path + ".tmp");
+        ofs << "PDP-CHECKPOINT 2 " << instanceHash << endl << best << endl << instances.str();
+        ofs.close();
+        rename((path + ".tmp").c_str(), path.c_str());
+    }
+
+    // search finished, checkpoint is no longer needed unless the search was stopped by the deadline
+    void finish() {
+        if (!deadline.isExpired()) remove(path.c_str());
+    }
+};
+
+/**
+ * Slave side of CheckpointWriter. Called by the feeder thread between pushes, so every instance received
+ * is either queued or searched when the snapshot is taken.
+ */
+void answerCheckpoint(LocalQueue &queue, int workReceived, MPI_Comm comm) {
+    int flag;
+    MPI_Iprobe(0, MessageTag::CHECKPOINT, comm, &flag, MPI_STATUS_IGNORE);
+    if (!flag) return;
+    MPI_Recv(nullptr, 0, MPI_CHAR, 0, MessageTag::CHECKPOINT, comm, MPI_STATUS_IGNORE);
+
+    ostringstream os;
+    os << "received " << workReceived << endl;
+    queue.snapshot(os);
+    string reply = queue.deadline.isExpired() ? "expired\n" : os.str();
+    MPI_Send(reply.data(), reply.size(), MPI_CHAR, 0, MessageTag::CHECKPOINT, comm);
+}
+
+// restores unfinished instances and best board written by CheckpointWriter, returns false if there is no checkpoint
+// of the instance in bestBoard, checkpoint of another instance or a damaged one is ignored
+bool loadCheckpoint(const string &path, ChessBoard &bestBoard, vector<Instance *> &insList) {
+    ifstream ifs(path);
+    string tag, hash;
+    int version;
+    if (!(ifs >> tag >> version >> hash) || tag != "PDP-CHECKPOINT" || version != 2) return false;
+    if (hash != bestBoard.hash()) {
+        cerr << "Checkpoint " << path << " patří jiné instanci, hledání začne znovu." << endl;
+        return false;
+    }
+
+    ChessBoard initBoard(bestBoard);
+    ChessBoard restoredBest(bestBoard);
+    vector<Instance *> restored;
+    bool valid = true;
+    long pathLen;
+    while (valid && ifs >> tag) {
+        if (tag == "best") {
+            ifs >> pathLen;
+            Instance *best = checkpointReplay(initBoard, ifs);
+            valid = best != nullptr;
+            if (valid && best->board.getPathLen() < restoredBest.getPathLen()) restoredBest = best->board;
+            delete best;
+        } else if (tag == "instance") {
+            Instance *ins = checkpointReplay(initBoard, ifs);
+            int cnt = -1;
+            valid = ins != nullptr && ifs >> cnt && cnt >= 0 && cnt <= initBoard.getMaxDepth();
+            if (!valid) {
+                delete ins;
+                break;
+            }
+            ins->resumePath.resize(cnt);
+            for (int &child : ins->resumePath) ifs >> child;
+            restored.push_back(ins);
+        }
+    }
+    if (!valid) {
+        cerr << "Checkpoint " << path << " je poškozený, hledání začne znovu." << endl;
+        for (const auto &ins : restored) delete ins;
+        return false;
+    }
+
+    bestBoard = restoredBest;
+    insList = restored;
+    for (const auto &ins : insList) ins->bestPathLen = bestBoard.getPathLen();
+    return true;
+}
+
+// next instance of insList or nullptr if there is none, shared by dispatching and master's worker pool
+Instance *takeInstance(vector<Instance *> &insList, size_t &insHead) {
+    Instance *ins = nullptr;
+#pragma omp critical(masterQueue)
+    {
+        if (insHead < insList.size()) ins = insList[insHead++];
+    }
+    return ins;
+}
+
+// master computes on the remaining cores, one core is left to the dispatching (main) thread
+thread startMasterWorker(LocalQueue &masterQueue, int searchThreadCnt, vector<Instance *> &insList,
+                         size_t &insHead, int &bestPathLen) {
+    return thread([&masterQueue, searchThreadCnt, &insList, &insHead, &bestPathLen]() {
+        runWorkerPool(masterQueue, searchThreadCnt, [&](LocalQueue &queue) {
+            if (queue.size() >= QUEUE_WATERMARK) {
+                this_thread::sleep_for(chrono::microseconds(100));
+                return true;
+            }
+            // instance is taken and pushed in one critical section, so CheckpointWriter always finds it somewhere
+            bool taken = false;
+#pragma omp critical(masterQueue)
+            {
+                if (insHead < insList.size()) {
+                    queue.offerBestPathLen(bestPathLen);
+                    queue.push(*insList[insHead++]);
+                    taken = true;
+                }
+            }
+            if (!taken) {
+                queue.close();
+                return false;
+            }
+            return true;
+        });
+    });
+}
+
+/**
+ * Flat topology, master process. Serves work requests of all slaves until each of them sends its final result.
+ */
+void runMasterFlat(vector<Instance *> &insList, int msgCapacity, IncumbentWindow *incumbent, Deadline &deadline,
+                   ChessBoard &bestBoard, CheckpointWriter *checkpoint, double &busyTime, SearchStats &stats) {
+    int myRank, processCount;
+    MPI_Comm_rank(MPI_COMM_WORLD, &myRank);
+    MPI_Comm_size(MPI_COMM_WORLD, &processCount);
+    int slaveCnt = processCount - 1;
+
+    PersistentReceive receive(msgCapacity, MPI_ANY_SOURCE);
+    SendBufferPool sendPool;
+    int bestPathLen = bestBoard.getPathLen();
+    size_t insHead = 0;
+    int msgLen = -1;
+    int slaveCntTerminated = 0;
+    vector<char> terminated(processCount, 0);
+    vector<vector<Instance *>> sentTo(processCount); // for checkpoint, WORK sent to each slave
+
+    // send initial work to each slave
+    for (int i = 1; i < processCount; i++) {
+        if (insHead < insList.size()) {
+            sentTo[i].push_back(insList[insHead]);
+            int slot = sendPool.acquire(insList[insHead]->serializedSize());
+            insList[insHead]->serializeToBuffer(sendPool.buffer(slot), sendPool.bufferLen(slot), msgLen);
+            cout << myRank << ": Posílam první instanci (" << msgLen << " bajtů) procesu " << i << endl;
+            sendPool.send(slot, msgLen, i, MessageTag::WORK);
+            insHead++;
+        } else {
+            int slot = sendPool.acquire(sizeof(bestPathLen));
+            memcpy(sendPool.buffer(slot), &bestPathLen, sizeof(bestPathLen));
+            sendPool.send(slot, sizeof(bestPathLen), i, MessageTag::FINISHED);
+        }
+    }
+
+    const int masterSearchThreadCnt = max({PROCNUM} - 1, 1);
+    LocalQueue masterQueue(bestBoard, deadline);
+    masterQueue.checkpointing = checkpoint != nullptr;
+    thread masterWorker = startMasterWorker(masterQueue, masterSearchThreadCnt, insList, insHead, bestPathLen);
+
+    MPI_Status status;
+    while (slaveCntTerminated < slaveCnt) {
+        if (checkpoint) {
+            checkpoint->requestIfDue(terminated);
+            if (checkpoint->poll()) checkpoint->write(insList, insHead, masterQueue, bestBoard, sentTo, terminated);
+        }
+        if (incumbent) {
+            int global = incumbent->sync(masterQueue.bestPathLen);
+            masterQueue.offerBestPathLen(global);
+#pragma omp critical(masterQueue)
+            bestPathLen = min(bestPathLen, global);
+        }
+        if (receive.test(status)) {
+            // deserialize best board of the slave straight from the receive buffer
+            MPI_Get_count(&status, MPI_CHAR, &msgLen);
+            ChessBoard receivedBoard = ChessBoard::deserializeFromBuffer(receive.data(), msgLen);
+            receive.restart();
+
+            // update best solution & take next work if there is any
+            Instance *ins = nullptr;
+#pragma omp critical(masterQueue)
+            {
+                // bestPathLen may already be lowered from the RMA window before the board that reached it arrives
+                if (receivedBoard.getPathLen() < bestBoard.getPathLen()) bestBoard = receivedBoard;
+                bestPathLen = min(bestPathLen, bestBoard.getPathLen());
+                if (masterQueue.bestPathLen < bestPathLen) bestPathLen = masterQueue.bestPathLen;
+                if (status.MPI_TAG == MessageTag::DONE && insHead < insList.size()) {
+                    ins = insList[insHead++];
+                    ins->bestPathLen = bestPathLen;
+                }
+            }
+
+            if (status.MPI_TAG == MessageTag::UPDATE) { // final result, slave has terminated
+                slaveCntTerminated++;
+                terminated[status.MPI_SOURCE] = 1;
+                if (checkpoint) checkpoint->slaveAnswered(status.MPI_SOURCE);
+            } else if (ins) {
+                sentTo[status.MPI_SOURCE].push_back(ins);
+                int slot = sendPool.acquire(ins->serializedSize());
+                ins->serializeToBuffer(sendPool.buffer(slot), sendPool.bufferLen(slot), msgLen);
+                sendPool.send(slot, msgLen, status.MPI_SOURCE, MessageTag::WORK);
+            } else { // send finish flag if there is no more work
+                int slot = sendPool.acquire(sizeof(bestPathLen));
+                memcpy(sendPool.buffer(slot), &bestPathLen, sizeof(bestPathLen));
+                sendPool.send(slot, sizeof(bestPathLen), status.MPI_SOURCE, MessageTag::FINISHED);
+            }
+        } else {
+            // do not steal the core from master's worker pool while waiting
+            this_thread::sleep_for(chrono::microseconds(100));
+        }
+    }
+    // master's own pool may still be searching after all slaves have terminated
+    while (checkpoint && !masterQueue.isFinished()) {
+        checkpoint->requestIfDue(terminated);
+        if (checkpoint->poll()) checkpoint->write(insList, insHead, masterQueue, bestBoard, sentTo, terminated);
+        this_thread::sleep_for(chrono::milliseconds(10));
+    }
+    masterWorker.join();
+    sendPool.waitAll();
+    if (checkpoint) checkpoint->finish();
+
+    if (masterQueue.bestBoard.getPathLen() < bestBoard.getPathLen()) bestBoard = masterQueue.bestBoard;
+    busyTime = masterQueue.busyTime / masterSearchThreadCnt;
+    stats = masterQueue.stats;
+}
+
+/**
+ * Flat topology, slave process. Asks master for more work whenever its local queue drops below watermark.
+ */
+void runSlaveFlat(const ChessBoard &board, int msgCapacity, IncumbentWindow *incumbent, Deadline &deadline,
+                  MPI_Comm checkpointComm, double &busyTime, SearchStats &stats) {
+    int myRank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &myRank);
+
+    PersistentReceive receive(msgCapacity, 0);
+    SendBufferPool sendPool;
+    MPI_Status status;
+    int msgLen = -1;
+
+    cout << myRank << ": Čekém na přidělení první instance" << endl;
+
+    receive.wait(status);
+    MPI_Get_count(&status, MPI_CHAR, &msgLen);
+
+    if (status.MPI_TAG == MessageTag::WORK) {
+        Instance firstInstance = Instance::deserializeFromBuffer(receive.data(), msgLen);
+        receive.restart();
+        LocalQueue queue(firstInstance.board, deadline);
+        queue.checkpointing = checkpointComm != MPI_COMM_NULL;
+        queue.offerBestPathLen(firstInstance.bestPathLen);
+        queue.push(firstInstance);
+        int workReceived = 1;
+
+        // one request for more work is in flight at a time, it is sent when the queue drops below watermark
+        bool requested = false;
+        runWorkerPool(queue, {PROCNUM}, [&](LocalQueue &q) {
+            if (q.checkpointing) answerCheckpoint(q, workReceived, checkpointComm);
+            if (incumbent) q.offerBestPathLen(incumbent->sync(q.bestPathLen));
+            if (!requested && q.size() < QUEUE_WATERMARK) {
+                int slot = sendPool.acquire(msgCapacity);
+                q.serializeBestBoard(sendPool.buffer(slot), sendPool.bufferLen(slot), msgLen);
+                sendPool.send(slot, msgLen, 0, MessageTag::DONE);
+                requested = true;
+            }
+
+            MPI_Status st;
+            if (!receive.test(st)) {
+                this_thread::sleep_for(chrono::microseconds(100));
+                return true;
+            }
+            if (st.MPI_TAG == MessageTag::FINISHED) {
+                q.close();
+                return false;
+            }
+            int len;
+            MPI_Get_count(&st, MPI_CHAR, &len);
+            Instance receivedInstance = Instance::deserializeFromBuffer(receive.data(), len);
+            receive.restart();
+            q.offerBestPathLen(receivedInstance.bestPathLen);
+            q.push(receivedInstance);
+            workReceived++;
+            requested = false;
+            return true;
+        });
+
+        // send final result
+        int slot = sendPool.acquire(queue.bestBoard.serializedSize());
+        queue.bestBoard.serializeToBuffer(sendPool.buffer(slot), sendPool.bufferLen(slot), msgLen);
+        sendPool.send(slot, msgLen, 0, MessageTag::UPDATE);
+        busyTime = queue.busyTime / {PROCNUM};
+        stats = queue.stats;
     } else {
-        ChessBoard bestBoard = ChessBoard(*earlySolution);
-        bestPathLen = bestBoard.getPathLen();
-        delete earlySolution;
-        return bestBoard;
+        // no work at all, report the empty result so master can count this slave as terminated
+        int slot = sendPool.acquire(ChessBoard::serializedSize());
+        ChessBoard emptyBoard(board);
+        emptyBoard.serializeToBuffer(sendPool.buffer(slot), sendPool.bufferLen(slot), msgLen);
+        sendPool.send(slot, msgLen, 0, MessageTag::UPDATE);
+    }
+    sendPool.waitAll();
+    cout << myRank << ": " << "Ukončuji se, master nemá další instance k vyřešení" << endl;
+}
+
+/*
+ * Block of instances sent from master to node leader:
+ * bestPathLen (int), instance count (int), [serialized length (int), serialized instance] * count
+ */
+int blockCapacity(int msgCapacity) {
+    return 2 * sizeof(int) + NODE_BLOCK_SIZE * (sizeof(int) + msgCapacity);
+}
+
+/**
+ * Hierarchical topology, master process. Keeps queue of its own node filled straight from insList and serves
+ * block requests of the other node leaders until each of them is told there is no more work.
+ */
+void runMasterHier(vector<Instance *> &insList, MPI_Comm nodeComm, MPI_Comm leaderComm, NodeQueue &nodeQueue,
+                   int msgCapacity, IncumbentWindow *incumbent, Deadline &deadline, ChessBoard &bestBoard,
+                   double &busyTime, SearchStats &stats) {
+    int leaderCnt;
+    MPI_Comm_size(leaderComm, &leaderCnt);
+
+    PersistentReceive receive(sizeof(int), MPI_ANY_SOURCE, leaderComm);
+    SendBufferPool sendPool(leaderComm);
+    int bestPathLen = bestBoard.getPathLen();
+    size_t insHead = 0;
+    int leaderCntTerminated = 0;
+
+    // nobody would take work from queue of node with master only
+    int nodeSize;
+    MPI_Comm_size(nodeComm, &nodeSize);
+    bool nodeQueueClosed = nodeSize == 1;
+    if (nodeQueueClosed) nodeQueue.close();
+
+    const int masterSearchThreadCnt = max({PROCNUM} - 1, 1);
+    LocalQueue masterQueue(bestBoard, deadline);
+    thread masterWorker = startMasterWorker(masterQueue, masterSearchThreadCnt, insList, insHead, bestPathLen);
+
+    MPI_Status status;
+    while (leaderCntTerminated < leaderCnt - 1 || !nodeQueueClosed) {
+        int global = nodeQueue.offerBestPathLen(min(long(bestPathLen), masterQueue.bestPathLen));
+        if (incumbent) global = min(global, incumbent->sync(global));
+        masterQueue.offerBestPathLen(global);
+#pragma omp critical(masterQueue)
+        bestPathLen = min(bestPathLen, global);
+
+        // own node is supplied directly
+        while (!nodeQueueClosed && nodeQueue.size() < NODE_BLOCK_SIZE) {
+            Instance *ins = takeInstance(insList, insHead);
+            if (!ins) {
+                nodeQueue.close();
+                nodeQueueClosed = true;
+            } else {
+                ins->bestPathLen = bestPathLen;
+                nodeQueue.push(*ins);
+            }
+        }
+
+        if (receive.test(status)) {
+            int leaderPathLen;
+            memcpy(&leaderPathLen, receive.data(), sizeof(leaderPathLen));
+            receive.restart();
+
+            vector<Instance *> block;
+#pragma omp critical(masterQueue)
+            {
+                bestPathLen = min(bestPathLen, leaderPathLen);
+                while (block.size() < NODE_BLOCK_SIZE && insHead < insList.size()) block.push_back(insList[insHead++]);
+            }
+
+            int slot = sendPool.acquire(blockCapacity(msgCapacity));
+            char *head = sendPool.buffer(slot);
+            int cnt = block.size();
+            memcpy(head, &bestPathLen, sizeof(bestPathLen));
+            head += sizeof(bestPathLen);
+            memcpy(head, &cnt, sizeof(cnt));
+            head += sizeof(cnt);
+            for (const auto &ins : block) {
+                int len;
+                ins->bestPathLen = bestPathLen;
+                ins->serializeToBuffer(head + sizeof(len), msgCapacity, len);
+                memcpy(head, &len, sizeof(len));
+                head += sizeof(len) + len;
+            }
+            if (cnt > 0) {
+                sendPool.send(slot, head - sendPool.buffer(slot), status.MPI_SOURCE, MessageTag::WORK);
+            } else {
+                sendPool.send(slot, head - sendPool.buffer(slot), status.MPI_SOURCE, MessageTag::FINISHED);
+                leaderCntTerminated++;
+            }
+        } else {
+            this_thread::sleep_for(chrono::microseconds(100));
+        }
+    }
+    masterWorker.join();
+    sendPool.waitAll();
+
+    if (masterQueue.bestBoard.getPathLen() < bestBoard.getPathLen()) bestBoard = masterQueue.bestBoard;
+    busyTime = masterQueue.busyTime / masterSearchThreadCnt;
+    stats = masterQueue.stats;
+}
+
+/**
+ * Hierarchical topology, any process but master. Takes work from queue of its node.
+ * Node leader (leaderComm != MPI_COMM_NULL) also refills the node queue with blocks from master.
+ */
+void runWorkerHier(const ChessBoard &board, MPI_Comm leaderComm, NodeQueue &nodeQueue, int msgCapacity,
+                   IncumbentWindow *incumbent, Deadline &deadline, ChessBoard &bestBoard, double &busyTime,
+                   SearchStats &stats) {
+    bool leader = leaderComm != MPI_COMM_NULL;
+    PersistentReceive *receive = leader ? new PersistentReceive(blockCapacity(msgCapacity), 0, leaderComm) : nullptr;
+    SendBufferPool sendPool(leader ? leaderComm : MPI_COMM_WORLD);
+    bool requested = false;
+    bool finished = false;
+
+    LocalQueue queue(board, deadline);
+    runWorkerPool(queue, {PROCNUM}, [&](LocalQueue &q) {
+        if (incumbent) q.offerBestPathLen(incumbent->sync(q.bestPathLen));
+        q.offerBestPathLen(nodeQueue.offerBestPathLen(q.bestPathLen));
+        bool idle = true;
+
+        if (leader && !finished) {
+            // one request for block is in flight at a time, it is sent when the node queue drops below block size
+            if (!requested && nodeQueue.size() < NODE_BLOCK_SIZE) {
+                int slot = sendPool.acquire(sizeof(int));
+                int pathLen = int(q.bestPathLen);
+                memcpy(sendPool.buffer(slot), &pathLen, sizeof(pathLen));
+                sendPool.send(slot, sizeof(pathLen), 0, MessageTag::DONE);
+                requested = true;
+            }
+
+            MPI_Status st;
+            if (receive->test(st)) {
+                idle = false;
+                char *head = receive->data();
+                int pathLen, cnt;
+                memcpy(&pathLen, head, sizeof(pathLen));
+                head += sizeof(pathLen);
+                memcpy(&cnt, head, sizeof(cnt));
+                head += sizeof(cnt);
+                for (int i = 0; i < cnt; i++) {
+                    int len;
+                    memcpy(&len, head, sizeof(len));
+                    head += sizeof(len);
+                    Instance ins = Instance::deserializeFromBuffer(head, len);
+                    head += len;
+                    nodeQueue.push(ins);
+                }
+                q.offerBestPathLen(nodeQueue.offerBestPathLen(pathLen));
+                if (st.MPI_TAG == MessageTag::FINISHED) {
+                    nodeQueue.close();
+                    finished = true;
+                } else {
+                    receive->restart();
+                }
+                requested = false;
+            }
+        }
+
+        if (q.size() < QUEUE_WATERMARK) {
+            bool closed;
+            bool stolen = nodeQueue.popInto(q, closed);
+            tracer.instant("steal", "success", stolen);
+            if (stolen) {
+                idle = false;
+            } else if (closed) {
+                q.close();
+                return false;
+            }
+        }
+
+        if (idle) this_thread::sleep_for(chrono::microseconds(100));
+        return true;
+    });
+    sendPool.waitAll();
+    delete receive;
+
+    bestBoard = queue.bestBoard;
+    busyTime = queue.busyTime / {PROCNUM};
+    stats = queue.stats;
+}
+
+// fields perf_<phase>_<counter> summed over threads and perf_<phase>_<counter>_by_thread, counts hold
+// PHASE_CNT * PERF_COUNTER_CNT values for each of threads; phases no thread has counted in are left out
+void addPerfCounts(RunReport &report, const vector<long> &counts, const vector<string> &threads) {
+    const int perThread = PHASE_CNT * PERF_COUNTER_CNT;
+    bool threadsAdded = false;
+    for (int p = 0; p < PHASE_CNT; p++) {
+        bool counted = false;
+        for (size_t i = 0; i < counts.size(); i++) counted |= int(i % perThread) / PERF_COUNTER_CNT == p && counts[i];
+        if (!counted) continue;
+        if (!threadsAdded) report.addList("perf_threads", threads);
+        threadsAdded = true;
+        for (int c = 0; c < PERF_COUNTER_CNT; c++) {
+            string name = string("perf_") + PERF_PHASE_NAMES[p] + "_" + PERF_COUNTER_NAMES[c];
+            long total = 0;
+            vector<long> byThread;
+            for (size_t t = 0; t < threads.size(); t++) {
+                byThread.push_back(counts[t * perThread + p * PERF_COUNTER_CNT + c]);
+                total += byThread.back();
+            }
+            report.addCount(name, total);
+            report.addCountList(name + "_by_thread", byThread);
+        }
     }
+}
 
+#ifdef PERF_COUNTERS
+// collective, hardware counters of threads of all ranks are added to the report of rank 0, thread is "rank.thread"
+void reducePerfCounts(RunReport &report, int myRank, int processCount) {
+    vector<long> mine = perfCounters.take();
+    int len = mine.size();
+    vector<int> lens(processCount), displs(processCount);
+    MPI_Gather(&len, 1, MPI_INT, lens.data(), 1, MPI_INT, 0, MPI_COMM_WORLD);
+    for (int i = 1; i < processCount; i++) displs[i] = displs[i - 1] + lens[i - 1];
+    vector<long> all(myRank == 0 ? displs[processCount - 1] + lens[processCount - 1] : 0);
+    MPI_Gatherv(mine.data(), len, MPI_LONG, all.data(), lens.data(), displs.data(), MPI_LONG, 0, MPI_COMM_WORLD);
+    if (myRank != 0) return;
+    vector<string> threads;
+    for (int i = 0; i < processCount; i++) {
+        for (int t = 0; t < lens[i] / (PHASE_CNT * PERF_COUNTER_CNT); t++) {
+            threads.push_back(to_string(i) + "." + to_string(t));
+        }
+    }
+    addPerfCounts(report, all, threads);
+}
+#endif
+
+// collective, events of all ranks are written by rank 0 to one trace, rank is the process id in the trace
+void writeTrace(const string &path, int myRank, int processCount) {
+    string mine = tracer.events(myRank, "rank " + to_string(myRank));
+    int len = mine.size();
+    vector<int> lens(processCount), displs(processCount);
+    MPI_Gather(&len, 1, MPI_INT, lens.data(), 1, MPI_INT, 0, MPI_COMM_WORLD);
+    for (int i = 1; i < processCount; i++) displs[i] = displs[i - 1] + lens[i - 1];
+    string all(myRank == 0 ? displs[processCount - 1] + lens[processCount - 1] : 0, ' ');
+    MPI_Gatherv(&mine[0], len, MPI_CHAR, &all[0], lens.data(), displs.data(), MPI_CHAR, 0, MPI_COMM_WORLD);
+    if (myRank != 0) return;
+    string events;
+    for (int i = 0; i < processCount; i++) events += (i ? ",\n" : "") + all.substr(displs[i], lens[i]);
+    Tracer::write(path, events);
+}
+
+// best board of all processes ends up on master
+void gatherBestBoard(ChessBoard &bestBoard, int msgCapacity) {
+    CommTimer timer;
+    int myRank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &myRank);
+
+    struct {
+        int pathLen;
+        int rank;
+    } mine{bestBoard.getPathLen(), myRank}, best;
+    MPI_Allreduce(&mine, &best, 1, MPI_2INT, MPI_MINLOC, MPI_COMM_WORLD);
+    if (best.rank == 0 || (myRank != 0 && myRank != best.rank)) return;
+
+    char *buf = nullptr;
+    int bufLen = 0;
+    ensureBufferSize(&buf, bufLen, msgCapacity);
+    if (myRank == 0) {
+        MPI_Recv(buf, bufLen, MPI_CHAR, best.rank, MessageTag::UPDATE, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+        bestBoard = ChessBoard::deserializeFromBuffer(buf, bufLen);
+    } else {
+        int msgLen;
+        bestBoard.serializeToBuffer(buf, bufLen, msgLen);
+        MPI_Send(buf, msgLen, MPI_CHAR, 0, MessageTag::UPDATE, MPI_COMM_WORLD);
+    }
+    MPI_Free_mem(buf);
 }
 
 int main(int argc, char **argv) {
-    MPI_Init(&argc, &argv);
+    // MPI is called only from the main thread, which is also the feeder thread of the worker pool
+    int threadSupport;
+    MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &threadSupport);
     int myRank, processCount, slaveCnt;
     MPI_Comm_rank(MPI_COMM_WORLD, &myRank);
     MPI_Comm_size(MPI_COMM_WORLD, &processCount);
     slaveCnt = processCount - 1;
 
-    const int bufLen = 1000000;
-    char buf[bufLen];
+    if (myRank == 0 && threadSupport < MPI_THREAD_FUNNELED) {
+        cerr << "MPI nepodporuje MPI_THREAD_FUNNELED" << endl;
+    }
+
+    // arguments: [--incumbent=msg|rma] [--topology=flat|hier] [--checkpoint-dir=DIR] [--checkpoint-period=SECONDS]
+    //            [--time-limit=SECONDS] [--report=FILE] [--trace=FILE] instance_file
+    // with checkpoint directory the search state is saved periodically and an interrupted run resumes from it
+    // with time limit the search stops at the deadline and reports the best solution found and its optimality gap
+    // with report file master appends a summary of the run to it, see RunReport
+    // with trace file master writes a timeline of all processes to it at exit, see Tracer
+    IncumbentMode incumbentMode = INCUMBENT_MSG;
+    Topology topology = TOPOLOGY_FLAT;
+    string filename, checkpointDir, reportPath, tracePath;
+    double checkpointPeriod = CHECKPOINT_PERIOD;
+    double timeLimit = NO_TIME_LIMIT;
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--incumbent=msg") incumbentMode = INCUMBENT_MSG;
+        else if (arg == "--incumbent=rma") incumbentMode = INCUMBENT_RMA;
+        else if (arg == "--topology=flat") topology = TOPOLOGY_FLAT;
+        else if (arg == "--topology=hier") topology = TOPOLOGY_HIER;
+        else if (arg.compare(0, 17, "--checkpoint-dir=") == 0) checkpointDir = arg.substr(17);
+        else if (arg.compare(0, 20, "--checkpoint-period=") == 0) checkpointPeriod = stod(arg.substr(20));
+        else if (arg.compare(0, 13, "--time-limit=") == 0) timeLimit = stod(arg.substr(13));
+        else if (arg.compare(0, 9, "--report=") == 0) reportPath = arg.substr(9);
+        else if (arg.compare(0, 8, "--trace=") == 0) tracePath = arg.substr(8);
+        else filename = arg;
+    }
+    MPI_Barrier(MPI_COMM_WORLD); // trace times of all processes start together
+    if (!tracePath.empty()) tracer.start();
+    if (!checkpointDir.empty() && topology != TOPOLOGY_FLAT) {
+        if (myRank == 0) cerr << "Checkpoint je podporován jen v topologii flat" << endl;
+        checkpointDir.clear();
+    }
+    string checkpointPath = checkpointDir.empty() ? "" :
+                            checkpointDir + "/" + filename.substr(filename.find_last_of('/') + 1) + ".checkpoint";
+    MPI_Comm checkpointComm = MPI_COMM_NULL;
+    if (!checkpointPath.empty()) MPI_Comm_dup(MPI_COMM_WORLD, &checkpointComm);
+    IncumbentWindow *incumbent = incumbentMode == INCUMBENT_RMA ? new IncumbentWindow(myRank) : nullptr;
+
+    // time spent searching per search thread, used for utilisation report
+    double busyTime = 0;
+    SearchStats stats;
 
     /* time measuring - start */
     double t1 = MPI_Wtime();
+    Deadline deadline(timeLimit, myRank);
+
+    ChessBoard bestBoard(filename);
+    double tLoaded = MPI_Wtime();
+    string instanceHash = bestBoard.hash();
+    Instance startInstance(bestBoard, 0, BISHOP, numeric_limits<int>::max());
+    // every message fits into buffer of this size
+    int msgCapacity = startInstance.maxSerializedSize();
 
-    if (myRank == 0) { // master process
-        Instance startInstance(ChessBoard(argv[1]), 0, BISHOP, numeric_limits<int>::max());
-        ChessBoard bestBoard(startInstance.board);
-        int bestPathLen = numeric_limits<int>::max();
+    vector<Instance *> insList;
+    if (myRank == 0) {
         //cout << startInstance.board << endl;
-        ChessBoard *earlyBoard = nullptr;
-        vector<Instance *> insList = generateInstancesFrom(startInstance, &earlyBoard);
-        if (earlyBoard) {
-            bestPathLen = earlyBoard->getPathLen();
-            bestBoard = *earlyBoard;
-            delete earlyBoard;
-            for (const auto &ins : insList) ins->bestPathLen = earlyBoard->getPathLen();
-        }
-        size_t insHead = 0;
-        int msgLen = -1;
-        int slaveCntTerminated = 0;
+        if (!checkpointPath.empty() && loadCheckpoint(checkpointPath, bestBoard, insList)) {
+            cout << "Obnoveno z checkpointu: " << checkpointPath << endl;
+        } else {
+            ChessBoard *earlyBoard = nullptr;
+            insList = generateInstancesFrom(startInstance, &earlyBoard);
+            if (earlyBoard) {
+                bestBoard = *earlyBoard;
+                delete earlyBoard;
+                for (const auto &ins : insList) ins->bestPathLen = bestBoard.getPathLen();
+            }
+        }
 
         cout << "Počet slave procesů: " << slaveCnt << endl;
+        cout << "Propagace nejlepšího řešení: " << (incumbentMode == INCUMBENT_RMA ? "rma" : "msg") << endl;
+        cout << "Topologie: " << (topology == TOPOLOGY_HIER ? "hier" : "flat") << endl;
         cout << "Počet vygenerovaných instancí: " << insList.size() << endl;
-
-        // send initial work to each slave
-        for (int i = 1; i < processCount; i++) {
-            insList[insHead]->serializeToBuffer(buf, bufLen, msgLen);
-            cout << myRank << ": Posílam první instanci (" << msgLen << " bajtů) procesu " << i << endl;
-            MPI_Send(buf, msgLen, MPI_CHAR, i, MessageTag::WORK, MPI_COMM_WORLD);
-            insHead++;
+    }
+    double tFrontier = MPI_Wtime();
+
+    if (topology == TOPOLOGY_FLAT) {
+        if (myRank == 0) { // master process
+            CheckpointWriter *checkpoint = checkpointPath.empty() ? nullptr :
+                                           new CheckpointWriter(checkpointPath, checkpointPeriod, checkpointComm,
+                                                                processCount, deadline, instanceHash);
+            runMasterFlat(insList, msgCapacity, incumbent, deadline, bestBoard, checkpoint, busyTime, stats);
+            delete checkpoint;
+        } else { // slave process
+            runSlaveFlat(bestBoard, msgCapacity, incumbent, deadline, checkpointComm, busyTime, stats);
         }
+    } else {
+        // one leader per node, master is the leader of its node and rank 0 of leaderComm
+        MPI_Comm nodeComm, leaderComm;
+        int nodeRank;
+        MPI_Comm_split_type(MPI_COMM_WORLD, MPI_COMM_TYPE_SHARED, myRank, MPI_INFO_NULL, &nodeComm);
+        MPI_Comm_rank(nodeComm, &nodeRank);
+        MPI_Comm_split(MPI_COMM_WORLD, nodeRank == 0 ? 0 : MPI_UNDEFINED, myRank, &leaderComm);
+
+        NodeQueue *nodeQueue = new NodeQueue(nodeComm, msgCapacity);
+        if (myRank == 0) {
+            int leaderCnt;
+            MPI_Comm_size(leaderComm, &leaderCnt);
+            cout << "Počet uzlů: " << leaderCnt << endl;
+            runMasterHier(insList, nodeComm, leaderComm, *nodeQueue, msgCapacity, incumbent, deadline, bestBoard,
+                          busyTime, stats);
+        } else {
+            runWorkerHier(bestBoard, leaderComm, *nodeQueue, msgCapacity, incumbent, deadline, bestBoard, busyTime,
+                          stats);
+        }
+        gatherBestBoard(bestBoard, msgCapacity);
+        delete nodeQueue;
 
-        // check for finished work from slaves
-        int flag;
-        MPI_Status status;
-        while (true) {
-            MPI_Iprobe(MPI_ANY_SOURCE, MessageTag::DONE, MPI_COMM_WORLD, &flag, &status);
-            if (flag) {
-                // receive & deserialize solution board
-                MPI_Get_count(&status, MPI_CHAR, &msgLen);
-                MPI_Recv(&buf[0], msgLen, MPI_CHAR, status.MPI_SOURCE, status.MPI_TAG, MPI_COMM_WORLD,
-                         MPI_STATUS_IGNORE);
-                ChessBoard receivedBoard = ChessBoard::deserializeFromBuffer(buf, msgLen);
-                //cout << myRank << ": Dostal jsem vyřešenou instaci od procesu " << status.MPI_SOURCE
-                     //<< " s délkou cesty " << receivedBoard.getPathLen() <<
-                     //" (best=" << bestPathLen << ")" << endl;
-
-                // update best solution
-                if (receivedBoard.getPathLen() < bestPathLen) {
-                    bestBoard = receivedBoard;
-                    bestPathLen = receivedBoard.getPathLen();
-                }
+        if (leaderComm != MPI_COMM_NULL) MPI_Comm_free(&leaderComm);
+        MPI_Comm_free(&nodeComm);
+    }
 
-                // send next work if there is any
-                if (insHead < insList.size()) {
-                    insList[insHead]->bestPathLen = bestPathLen;
-                    insList[insHead]->serializeToBuffer(buf, bufLen, msgLen);
-                    MPI_Send(buf, msgLen, MPI_CHAR, status.MPI_SOURCE, MessageTag::WORK, MPI_COMM_WORLD);
-                    insHead++;
-                } else { // send finish flag if there is no more work
-                    MPI_Send(&bestPathLen, 1, MPI_INT, status.MPI_SOURCE, MessageTag::FINISHED,
-                             MPI_COMM_WORLD);
-                    slaveCntTerminated++;
-                }
-            }
-            if (slaveCntTerminated == slaveCnt) break;
-        }
+    double tSearched = MPI_Wtime();
 
+    deadline.finish();
+    deadline.report(bestBoard.getPathLen());
+
+    if (myRank == 0) {
         cout << "===========ŘEŠENÍ============" << endl;
         cout << "Počet tahů: " << bestBoard.getMoveLog().size() << endl;
         for (const auto &move : bestBoard.getMoveLog()) {
@@ -827,46 +2906,58 @@ int main(int argc, char **argv) {
 
         // cleanup
         for (const auto &ins : insList) delete ins;
-    } else { // slave process
-        int flag;
-        MPI_Status status;
-        long counterSlave = 0;
-        int msgLen = -1;
-
-        cout << myRank << ": Čekém na přidělení první instance" << endl;
-
-        while (true) {
-            MPI_Iprobe(MPI_ANY_SOURCE, MPI_ANY_TAG, MPI_COMM_WORLD, &flag, &status);
-            if (flag) {
-                if (status.MPI_TAG == MessageTag::WORK) {
-                    // receive & deserializeFromBuffer message
-                    MPI_Get_count(&status, MPI_CHAR, &msgLen);
-                    //cout << myRank << ": " << "Dostal jsem instanci (" << msgLen << " bajtů) k vyřešení" << endl;
-                    MPI_Recv(buf, msgLen, MPI_CHAR, status.MPI_SOURCE, status.MPI_TAG, MPI_COMM_WORLD,
-                             MPI_STATUS_IGNORE);
-                    Instance receivedInstance = Instance::deserializeFromBuffer(buf, msgLen);
-
-                    // run
-                    long bestPathLenSlave = receivedInstance.bestPathLen;
-                    ChessBoard bestBoard = bbDfsDataPar(receivedInstance, bestPathLenSlave, counterSlave);
-
-                    // send result
-                    bestBoard.serializeToBuffer(buf, bufLen, msgLen);
-                    MPI_Send(buf, msgLen, MPI_CHAR, 0, MessageTag::DONE, MPI_COMM_WORLD);
-                    //cout << myRank << ": " << "Odeslal jsem vyřešenou instanci s délkou cesty "
-                         //<< bestBoard.getPathLen() << endl;
-                } else if (status.MPI_TAG == MessageTag::FINISHED) {
-                    cout << myRank << ": " << "Ukončuji se, master nemá další instance k vyřešení" << endl;
-                    break;
-                }
-            }
-        }
     }
+    stats.printProfile(myRank);
 
     /* time measuring - stop */
     double t2 = MPI_Wtime();
     printf ("%d: Elapsed time is %f.\n",myRank,t2-t1);
 
+    // utilisation of each process = time spent computing / elapsed time
+    vector<double> busyTimes(processCount);
+    vector<double> elapsedTimes(processCount);
+    double elapsed = t2 - t1;
+    MPI_Gather(&busyTime, 1, MPI_DOUBLE, busyTimes.data(), 1, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+    MPI_Gather(&elapsed, 1, MPI_DOUBLE, elapsedTimes.data(), 1, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+    if (myRank == 0) {
+        cout << "===========VYTÍŽENÍ===========" << endl;
+        for (int i = 0; i < processCount; i++) {
+            printf("%d: Utilisation is %.1f %% (%f of %f).\n", i, 100 * busyTimes[i] / elapsedTimes[i],
+                   busyTimes[i], elapsedTimes[i]);
+        }
+        cout << "==============================" << endl;
+    }
+
+    if (!reportPath.empty()) {
+        // phases of master, except communication, which is the longest of all processes
+        double maxCommTime;
+        MPI_Reduce(&commTime, &maxCommTime, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+        RunReport report;
+        if (myRank == 0) {
+            report.addText("engine", topology == TOPOLOGY_HIER ? "mpi-hier" : "mpi-flat");
+            report.addCount("threads", {PROCNUM});
+            report.addCount("ranks", processCount);
+            report.addText("instance", filename);
+            report.addText("instance_hash", instanceHash);
+            report.addCount("cost", bestBoard.getPawnCnt() == 0 ? bestBoard.getPathLen() : -1);
+        }
+        stats.reduceTo(report, myRank);
+#ifdef PERF_COUNTERS
+        reducePerfCounts(report, myRank, processCount);
+#endif
+        if (myRank == 0) {
+            report.addTime("load_ms", 1000 * (tLoaded - t1));
+            report.addTime("frontier_ms", 1000 * (tFrontier - tLoaded));
+            report.addTime("search_ms", 1000 * (tSearched - tFrontier));
+            report.addTime("comm_ms", 1000 * maxCommTime);
+            report.addList("moves", bestBoard.getMoveLog());
+            report.append(reportPath);
+        }
+    }
+
+    delete incumbent;
+    if (checkpointComm != MPI_COMM_NULL) MPI_Comm_free(&checkpointComm);
+    if (!tracePath.empty()) writeTrace(tracePath, myRank, processCount);
     MPI_Finalize();
     return 0;
 }
@@ -5,7 +5,27 @@
 #include <limits>
 #include <chrono>
 #include <algorithm>
+#include <cstdint>
+#include <map>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sstream>
+#include <iomanip>
+#include <atomic>
+#include <type_traits>
+#include <cstdio>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <dirent.h>
 #include <omp.h>
+#ifdef PERF_COUNTERS
+#include <cerrno>
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#endif
 
 // chess pieces
 #define HORSE  'J'
@@ -13,6 +33,41 @@
 #define PAWN 'P'
 #define EMPTY '-'
 
+#ifndef MAX_ROW_LEN
+#define MAX_ROW_LEN 16 // longest side of a board, bounds the grid of ChessBoard and the move lists
+#endif
+#ifndef MAX_DEPTH
+#define MAX_DEPTH 64 // largest max depth of an instance, bounds the move log of ChessBoard
+#endif
+#define HORSE_MOVE_CAPACITY 8
+#define BISHOP_MOVE_CAPACITY (2 * (MAX_ROW_LEN - 1)) // both diagonals through the square
+#define MAX_MOVE_COST 3 // of EvalPosition
+#ifdef MAILBOX_BOARD
+#define BOARD_BORDER 2 // sentinel rows and columns around the grid, a horse jump from the board stays in them
+#else
+#define BOARD_BORDER 0
+#endif
+#define GRID_CAPACITY ((MAX_ROW_LEN + 2 * BOARD_BORDER) * (MAX_ROW_LEN + 2 * BOARD_BORDER))
+
+// returns fn<N>(args...) with N the side of board g, kernels of the sizes we run are specialised at compile time
+// (constant index arithmetic and bounds), other sizes use fn<0>, which reads the side from the board
+#define DISPATCH_ROW_LEN(g, fn, ...) \
+    switch ((g).getRowLen()) { \
+        case 5: return fn<5>(__VA_ARGS__); \
+        case 6: return fn<6>(__VA_ARGS__); \
+        case 7: return fn<7>(__VA_ARGS__); \
+        case 8: return fn<8>(__VA_ARGS__); \
+        case 9: return fn<9>(__VA_ARGS__); \
+        case 10: return fn<10>(__VA_ARGS__); \
+        case 11: return fn<11>(__VA_ARGS__); \
+        case 12: return fn<12>(__VA_ARGS__); \
+        case 13: return fn<13>(__VA_ARGS__); \
+        case 14: return fn<14>(__VA_ARGS__); \
+        case 15: return fn<15>(__VA_ARGS__); \
+        case 16: return fn<16>(__VA_ARGS__); \
+        default: return fn<0>(__VA_ARGS__); \
+    }
+
 
 // relative mapping for all possible horse movements
 // [ROW, COL]
@@ -32,12 +87,107 @@ const int HORSE_CAND[8][2] = {
 
 #define EPOCH_CNT 3
 
+#define CHECKPOINT_DEPTH 8 // number of DFS levels below instance whose position is saved to checkpoint
+#define CHECKPOINT_PERIOD 60 // default period of saving checkpoint [s]
+
 using namespace std;
 
+/**
+ * Binary instance file (pack) mapped to memory, written by tools/saj2bin.py, all numbers little-endian.
+ * Header: magic "SAJB", version, instance count, reserved (uint32 each), record offsets (uint64 * count).
+ * Record: rowLen, maxDepth, horse square, bishop square (uint32 each), pawn bitset (uint64 * ceil(rowLen^2 / 64)),
+ * square of (row, col) is row * rowLen + col.
+ * Packs stay mapped until the process exits, processes on one node share the mapped pages.
+ */
+class InstancePack {
+public:
+    static const uint32_t VERSION = 1;
+    static const size_t HEADER_LEN = 16;
+
+    struct Record {
+        uint32_t rowLen;
+        uint32_t maxDepth;
+        uint32_t horse;
+        uint32_t bishop;
+
+        bool hasPawn(int square) const {
+            const uint64_t *pawns = reinterpret_cast<const uint64_t *>(this + 1);
+            return (pawns[square / 64] >> (square % 64)) & 1;
+        }
+    };
+
+private:
+    string path;
+    const char *data;
+    size_t len;
+
+    InstancePack(const string &path, const char *data, size_t len) : path(path), data(data), len(len) {}
+
+    [[noreturn]] void fail(const string &message) const {
+        cerr << path << ": " << message << endl;
+        exit(1);
+    }
+
+public:
+    // nullptr if path is not a pack, packs are cached by path, exits on unknown version or truncated header
+    static const InstancePack *open(const string &path) {
+        static map<string, InstancePack *> packs;
+        auto it = packs.find(path);
+        if (it != packs.end()) return it->second;
+
+        InstancePack *pack = nullptr;
+        int fd = ::open(path.c_str(), O_RDONLY);
+        struct stat st;
+        if (fd >= 0 && fstat(fd, &st) == 0 && size_t(st.st_size) >= HEADER_LEN) {
+            void *mapped = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+            if (mapped != MAP_FAILED) {
+                if (memcmp(mapped, "SAJB", 4) == 0) pack = new InstancePack(path, (const char *) mapped, st.st_size);
+                else munmap(mapped, st.st_size);
+            }
+        }
+        if (fd >= 0) close(fd);
+        if (pack) {
+            uint32_t version = reinterpret_cast<const uint32_t *>(pack->data)[1];
+            if (version != VERSION) {
+                pack->fail("neznámá verze balíku " + to_string(version) + ", podporovaná je " + to_string(VERSION));
+            }
+            if (pack->len < HEADER_LEN + 8 * uint64_t(pack->count())) {
+                pack->fail("zkrácený balík, " + to_string(pack->len) + " bajtů nestačí na hlavičku s " +
+                           to_string(pack->count()) + " instancemi");
+            }
+        }
+        packs[path] = pack;
+        return pack;
+    }
+
+    uint32_t count() const {
+        return reinterpret_cast<const uint32_t *>(data)[2];
+    }
+
+    // exits if there is no such instance or its record does not fit in the pack
+    const Record &record(int index) const {
+        if (index < 0 || uint32_t(index) >= count()) {
+            fail("instance " + to_string(index) + " není v balíku s " + to_string(count()) + " instancemi");
+        }
+        uint64_t offset = reinterpret_cast<const uint64_t *>(data + HEADER_LEN)[index];
+        if (offset < HEADER_LEN + 8 * uint64_t(count()) || offset > len || len - offset < sizeof(Record)) {
+            fail("záznam instance " + to_string(index) + " na pozici " + to_string(offset) + " je mimo balík");
+        }
+        const Record &rec = *reinterpret_cast<const Record *>(data + offset);
+        uint64_t squares = uint64_t(rec.rowLen) * rec.rowLen;
+        if (len - offset - sizeof(Record) < 8 * ((squares + 63) / 64)) {
+            fail("záznam instance " + to_string(index) + " přesahuje konec balíku");
+        }
+        if (rec.horse >= squares || rec.bishop >= squares) {
+            fail("kůň nebo střelec instance " + to_string(index) + " je mimo šachovnici");
+        }
+        return rec;
+    }
+};
+
 class ChessBoard {
 private:
-    char *grid = nullptr;
-    int size;
+    char grid[GRID_CAPACITY]; // rows of the side plus both borders, see square
     int row_len;
     int pawn_cnt;
     int min_depth;
@@ -46,21 +196,42 @@ private:
     int max_depth;
 
 
+    // index of (row, col) in grid, N as in at<N>
+    template<int N>
+    int square(int row, int col) const {
+        return (row + BOARD_BORDER) * ((N ? N : row_len) + 2 * BOARD_BORDER) + col + BOARD_BORDER;
+    }
+
+    // grid of EMPTY squares surrounded by BOARD_BORDER squares of INVALID_AT
+    void initGrid() {
+        memset(grid, INVALID_AT, sizeof(grid));
+        for (int row = 0; row < row_len; row++) memset(grid + square<0>(row, 0), EMPTY, row_len);
+    }
+
     void setAt(int row, int col, char value) {
-        grid[row * row_len + col] = value;
+        grid[square<0>(row, col)] = value;
     }
 
     class ChessMove {
     private:
-        int row;
-        int col;
+        unsigned char row;
+        unsigned char col;
         bool tookPawn;
     public:
         ChessMove(int row, int col, bool tookPawn) : row(row), col(col), tookPawn(tookPawn) {}
 
+        ChessMove() = default;
+
+        int getRow() const {
+            return row;
+        }
+
+        int getCol() const {
+            return col;
+        }
 
         friend ostream &operator<<(ostream &os, const ChessMove &m) {
-            os << m.row << "," << m.col;
+            os << int(m.row) << "," << int(m.col);
             if (m.tookPawn) os << " *";
             return os;
         }
@@ -102,11 +273,13 @@ private:
 
     ChessPiece bishop;
     ChessPiece horse;
-    vector<ChessMove> move_log;
+    // moves played from the initial board, stored in the board, so that it is a value without pointers
+    ChessMove move_log[MAX_DEPTH];
+    int move_cnt = 0;
 
     void logMovePiece(int row, int col) {
         bool tookPawn = at(row, col) == PAWN;
-        move_log.emplace_back(ChessMove(row, col, tookPawn));
+        move_log[move_cnt++] = ChessMove(row, col, tookPawn);
     }
 
     void movePiece(ChessPiece &p, int row, int col) {
@@ -118,70 +291,94 @@ private:
         p.setCol(col);
     }
 
+    void loadRecord(const InstancePack::Record &rec) {
+        row_len = rec.rowLen;
+        max_depth = rec.maxDepth;
+        pawn_cnt = 0;
+        initGrid();
+        for (int i = 0; i < row_len * row_len; i++) {
+            if (rec.hasPawn(i)) {
+                setAt(i / row_len, i % row_len, PAWN);
+                pawn_cnt++;
+            }
+        }
+        horse = ChessPiece(rec.horse / row_len, rec.horse % row_len, HORSE);
+        bishop = ChessPiece(rec.bishop / row_len, rec.bishop % row_len, BISHOP);
+        setAt(horse.getRow(), horse.getCol(), HORSE);
+        setAt(bishop.getRow(), bishop.getCol(), BISHOP);
+        min_depth = pawn_cnt;
+    }
+
 public:
 
     // returned when accessing invalid position in chess board
     const static char INVALID_AT = '\0';
 
+    // grid and move log are stored in the board, larger instances need larger limits at compile time
+    static void checkLimits(int rowLen, int maxDepth, const string &filename) {
+        if (rowLen > MAX_ROW_LEN) {
+            cerr << filename << ": šachovnice " << rowLen << "x" << rowLen << " je větší než podporovaná "
+                 << MAX_ROW_LEN << "x" << MAX_ROW_LEN << ", přeložte s -DMAX_ROW_LEN=" << rowLen << endl;
+            exit(1);
+        }
+        if (maxDepth > MAX_DEPTH) {
+            cerr << filename << ": maximální hloubka " << maxDepth << " je větší než podporovaná " << MAX_DEPTH
+                 << ", přeložte s -DMAX_DEPTH=" << maxDepth << endl;
+            exit(1);
+        }
+    }
+
+    // instance file in text format, or binary pack, "pack#i" is i-th instance of the pack
     ChessBoard(const string &filename) {
+        size_t sep = filename.find_last_of('#');
+        const InstancePack *pack = InstancePack::open(filename.substr(0, sep));
+        if (pack) {
+            const InstancePack::Record &rec = pack->record(sep == string::npos ? 0 : stoi(filename.substr(sep + 1)));
+            checkLimits(rec.rowLen, rec.maxDepth, filename);
+            loadRecord(rec);
+            return;
+        }
+
         ifstream ifs(filename);
         ifs >> row_len;
         ifs >> max_depth;
-        size = row_len * row_len;
+        checkLimits(row_len, max_depth, filename);
         pawn_cnt = 0;
-        grid = new char[size];
-        memset(grid, EMPTY, size);
+        initGrid();
 
         char c;
-        char *head = grid;
-        while (ifs.get(c) && head < grid + size) {
+        int idx = 0;
+        while (ifs.get(c) && idx < row_len * row_len) {
             if (c != '\n' && c != '\r') {
-                int idx = int(head - grid);
                 int row = int(idx / row_len);
                 int col = idx % row_len;
                 if (c == BISHOP) bishop = ChessPiece(row, col, BISHOP);
                 if (c == HORSE) horse = ChessPiece(row, col, HORSE);
                 if (c == PAWN) pawn_cnt++;
-                *(head++) = c;
+                setAt(row, col, c);
+                idx++;
             }
         }
         ifs.close();
         min_depth = pawn_cnt;
     };
 
-    ChessBoard(const ChessBoard &oth) {
-        grid = new char[oth.size];
-        memcpy(grid, oth.grid, oth.size);
-        size = oth.size;
-        row_len = oth.row_len;
-        bishop = oth.bishop;
-        horse = oth.horse;
-        pawn_cnt = oth.pawn_cnt;
-        min_depth = oth.min_depth;
-        max_depth = oth.max_depth;
-        move_log = oth.move_log;
-    };
-
-    ChessBoard &operator=(const ChessBoard &oth) {
-        memcpy(grid, oth.grid, oth.size);
-        size = oth.size;
-        row_len = oth.row_len;
-        bishop = oth.bishop;
-        horse = oth.horse;
-        pawn_cnt = oth.pawn_cnt;
-        min_depth = oth.min_depth;
-        max_depth = oth.max_depth;
-        move_log = oth.move_log;
-        return *this;
-    }
+    // plain value, copying a board copies its bytes and allocates nothing
+    ChessBoard() = default;
 
-    ~ChessBoard() {
-        delete[] grid;
-    }
+    // board of side N, or of side row_len if N is 0, see DISPATCH_ROW_LEN
+    // with MAILBOX_BOARD squares off the board are read unchecked from the border, at most BOARD_BORDER away
+    template<int N>
+    char at(int row, int col) const {
+#ifndef MAILBOX_BOARD
+        const int n = N ? N : row_len;
+        if (row < 0 || col < 0 || row >= n || col >= n) return INVALID_AT;
+#endif
+        return grid[square<N>(row, col)];
+    };
 
     char at(int row, int col) const {
-        if (row < 0 || col < 0 || row >= row_len || col >= row_len) return INVALID_AT;
-        return grid[row * row_len + col];
+        return at<0>(row, col);
     };
 
     void moveBishop(int row, int col) {
@@ -212,8 +409,24 @@ public:
         return row_len;
     }
 
-    const vector<ChessMove> &getMoveLog() const {
-        return move_log;
+    vector<ChessMove> getMoveLog() const {
+        return vector<ChessMove>(move_log, move_log + move_cnt);
+    }
+
+    int getMoveCnt() const {
+        return move_cnt;
+    }
+
+    // FNV-1a hash of side length, max depth and grid as hex string, same for text and binary instance file
+    string hash() const {
+        uint64_t h = 14695981039346656037ULL;
+        auto mix = [&h](unsigned char byte) { h = (h ^ byte) * 1099511628211ULL; };
+        for (int shift = 0; shift < 32; shift += 8) mix((unsigned char) (row_len >> shift));
+        for (int shift = 0; shift < 32; shift += 8) mix((unsigned char) (max_depth >> shift));
+        for (int i = 0; i < row_len * row_len; i++) mix((unsigned char) at(i / row_len, i % row_len));
+        char buf[17];
+        snprintf(buf, sizeof(buf), "%016llx", (unsigned long long) h);
+        return buf;
     }
 
     friend ostream &operator<<(ostream &os, const ChessBoard &g) {
@@ -222,8 +435,8 @@ public:
         os << "Kůň na (" << g.horse.getRow() << "," << g.horse.getCol() << ")" << endl;
         os << "Střelec na (" << g.bishop.getRow() << "," << g.bishop.getCol() << ")" << endl;
         os << "Počet pěšáků " << g.pawn_cnt << endl;
-        for (int i = 0; i < g.size; i++) {
-            os << g.grid[i];
+        for (int i = 0; i < g.row_len * g.row_len; i++) {
+            os << g.at(i / g.row_len, i % g.row_len);
             if ((i + 1) % g.row_len) os << " | ";
             else os << endl;
         }
@@ -235,62 +448,75 @@ public:
     }
 };
 
+// frontier vectors, task captures and messages copy boards byte by byte
+static_assert(is_trivially_copyable<ChessBoard>::value, "ChessBoard musí být triviálně kopírovatelná");
+
 class EvalPosition {
 public:
+    static int for_horse(const ChessBoard &g, int row, int col) {
+        DISPATCH_ROW_LEN(g, for_horse, g, row, col)
+    }
+
+    static int for_bishop(const ChessBoard &g, int row, int col) {
+        DISPATCH_ROW_LEN(g, for_bishop, g, row, col)
+    }
+
+    template<int N>
     static int for_horse(const ChessBoard &g, int row, int col) {
         // take pawn
-        if (g.at(row, col) == PAWN) return 3;
+        if (g.at<N>(row, col) == PAWN) return 3;
 
         // take pawn next move
         for (const auto &cand : HORSE_CAND) {
-            if (g.at(row + cand[0], col + cand[1]) == PAWN)
+            if (g.at<N>(row + cand[0], col + cand[1]) == PAWN)
                 return 2;
         }
 
         // one square away from pawn
         if (
-                g.at(row + 1, col + 1) == PAWN ||
-                g.at(row + 1, col - 1) == PAWN ||
-                g.at(row + 1, col) == PAWN ||
-                g.at(row - 1, col - 1) == PAWN ||
-                g.at(row - 1, col + 1) == PAWN ||
-                g.at(row - 1, col) == PAWN ||
-                g.at(row, col + 1) == PAWN ||
-                g.at(row, col - 1) == PAWN
+                g.at<N>(row + 1, col + 1) == PAWN ||
+                g.at<N>(row + 1, col - 1) == PAWN ||
+                g.at<N>(row + 1, col) == PAWN ||
+                g.at<N>(row - 1, col - 1) == PAWN ||
+                g.at<N>(row - 1, col + 1) == PAWN ||
+                g.at<N>(row - 1, col) == PAWN ||
+                g.at<N>(row, col + 1) == PAWN ||
+                g.at<N>(row, col - 1) == PAWN
                 )
             return 1;
 
         return 0;
     };
 
+    template<int N>
     static int for_bishop(const ChessBoard &g, int row, int col) {
-        if (g.at(row, col) == PAWN) return 2;
+        if (g.at<N>(row, col) == PAWN) return 2;
         char c;
 
         // DIAG DOWN RIGHT
         for (int i = 1;; i++) {
-            c = g.at(row + i, col + i);
+            c = g.at<N>(row + i, col + i);
             if (c == ChessBoard::INVALID_AT || c == HORSE) break;
             if (c == PAWN) return 1;
         }
 
         // DIAG DOWN LEFT
         for (int i = 1;; i++) {
-            c = g.at(row + i, col - i);
+            c = g.at<N>(row + i, col - i);
             if (c == ChessBoard::INVALID_AT || c == HORSE) break;
             if (c == PAWN) return 1;
         }
 
         // DIAG UP RIGHT
         for (int i = 1;; i++) {
-            c = g.at(row - i, col + i);
+            c = g.at<N>(row - i, col + i);
             if (c == ChessBoard::INVALID_AT || c == HORSE) break;
             if (c == PAWN) return 1;
         }
 
         // DIAG UP LEFT
         for (int i = 1;; i++) {
-            c = g.at(row - i, col - i);
+            c = g.at<N>(row - i, col - i);
             if (c == ChessBoard::INVALID_AT || c == HORSE) break;
             if (c == PAWN) return 1;
         }
@@ -313,85 +539,164 @@ public:
 
         NextMove(int row, int col, int cost) : row(row), col(col), cost(cost) {}
 
-        static bool add_bishop_if_possible(int row, int col, const ChessBoard &g, vector<NextMove> &moves) {
-            char c = g.at(row, col);
+        template<int N, class Moves>
+        static bool add_bishop_if_possible(int row, int col, const ChessBoard &g, Moves &moves) {
+            char c = g.at<N>(row, col);
             if (c == HORSE || c == ChessBoard::INVALID_AT) {
                 return false;
             }
             if (c == PAWN) {
-                moves.emplace_back(row, col, EvalPosition::for_bishop(g, row, col));
+                moves.add(row, col, EvalPosition::for_bishop<N>(g, row, col));
                 return false;
             }
             if (c == EMPTY) {
-                moves.emplace_back(row, col, EvalPosition::for_bishop(g, row, col));
+                moves.add(row, col, EvalPosition::for_bishop<N>(g, row, col));
                 return true;
             }
             return false;
         }
 
-        static bool add_horse_if_possible(int row, int col, const ChessBoard &g, vector<NextMove> &moves) {
-            char c = g.at(row, col);
+        template<int N, class Moves>
+        static bool add_horse_if_possible(int row, int col, const ChessBoard &g, Moves &moves) {
+            char c = g.at<N>(row, col);
             if (c == EMPTY || c == PAWN) {
-                moves.emplace_back(row, col, EvalPosition::for_horse(g, row, col));
+                moves.add(row, col, EvalPosition::for_horse<N>(g, row, col));
                 return true;
             }
             return false;
         }
 
-        struct comparator {
-            bool operator()(const NextMove &a, const NextMove &b) const {
-                return a.cost > b.cost;
-            }
-        };
+    };
+
+    // moves of one node in a fixed-capacity buffer, generating them does not allocate
+    template<int CAPACITY>
+    class MoveList {
+    private:
+        NextMove items[CAPACITY];
+        int cnt = 0;
+
+    public:
+        void add(int row, int col, int cost) {
+            items[cnt++] = NextMove(row, col, cost);
+        }
 
+        // counting sort on cost, highest first, moves of the same cost keep the order they were generated in
+        void sortByCost() {
+            int start[MAX_MOVE_COST + 2] = {};
+            for (int i = 0; i < cnt; i++) start[MAX_MOVE_COST - items[i].cost + 1]++;
+            for (int c = 1; c <= MAX_MOVE_COST + 1; c++) start[c] += start[c - 1];
+            NextMove sorted[CAPACITY];
+            for (int i = 0; i < cnt; i++) sorted[start[MAX_MOVE_COST - items[i].cost]++] = items[i];
+            copy(sorted, sorted + cnt, items);
+        }
+
+        size_t size() const {
+            return cnt;
+        }
+
+        bool empty() const {
+            return cnt == 0;
+        }
+
+        const NextMove &operator[](size_t i) const {
+            return items[i];
+        }
+
+        const NextMove *begin() const {
+            return items;
+        }
+
+        const NextMove *end() const {
+            return items + cnt;
+        }
     };
 
-    static vector<NextMove> for_horse(const ChessBoard &g) {
+    typedef MoveList<HORSE_MOVE_CAPACITY> HorseMoves;
+    typedef MoveList<BISHOP_MOVE_CAPACITY> BishopMoves;
+
+    static HorseMoves for_horse(const ChessBoard &g) {
+        DISPATCH_ROW_LEN(g, for_horse, g)
+    }
+
+    static BishopMoves for_bishop(const ChessBoard &g) {
+        DISPATCH_ROW_LEN(g, for_bishop, g)
+    }
+
+    template<int N>
+    static HorseMoves for_horse(const ChessBoard &g) {
         int row = g.getHorse().getRow();
         int col = g.getHorse().getCol();
-        vector<NextMove> moves = vector<NextMove>();
-        moves.reserve(8);
+        HorseMoves moves;
         for (const auto &cand : HORSE_CAND) {
-            NextMove::add_horse_if_possible(cand[0] + row, cand[1] + col, g, moves);
+            NextMove::add_horse_if_possible<N>(cand[0] + row, cand[1] + col, g, moves);
         }
 
-        sort(moves.begin(), moves.end(), NextPossibleMoves::NextMove::comparator());
+        moves.sortByCost();
         return moves;
     };
 
-    static vector<NextMove> for_bishop(const ChessBoard &g) {
-        vector<NextMove> moves = vector<NextMove>();
-        moves.reserve(2 * g.getRowLen() - 2);
+    template<int N>
+    static BishopMoves for_bishop(const ChessBoard &g) {
+        BishopMoves moves;
         int row = g.getBishop().getRow();
         int col = g.getBishop().getCol();
 
         // DIAG UP RIGHT
         for (int i = 1;; i++) {
-            if (!NextMove::add_bishop_if_possible(row - i, col + i, g, moves)) break;
+            if (!NextMove::add_bishop_if_possible<N>(row - i, col + i, g, moves)) break;
         }
 
         // DIAG UP LEFT
         for (int i = 1;; i++) {
-            if (!NextMove::add_bishop_if_possible(row - i, col - i, g, moves)) break;
+            if (!NextMove::add_bishop_if_possible<N>(row - i, col - i, g, moves)) break;
         }
 
         // DIAG DOWN RIGHT
         for (int i = 1;; i++) {
-            if (!NextMove::add_bishop_if_possible(row + i, col + i, g, moves)) break;
+            if (!NextMove::add_bishop_if_possible<N>(row + i, col + i, g, moves)) break;
         }
 
         // DIAG DOWN LEFT
         for (int i = 1;; i++) {
-            if (!NextMove::add_bishop_if_possible(row + i, col - i, g, moves)) break;
+            if (!NextMove::add_bishop_if_possible<N>(row + i, col - i, g, moves)) break;
         }
 
-        sort(moves.begin(), moves.end(), NextPossibleMoves::NextMove::comparator());
+        moves.sortByCost();
         return moves;
     };
 
 };
 
 
+struct BishopPlay;
+
+// side to move as a type, the search is instantiated for each side and alternates them at compile time
+struct HorsePlay {
+    typedef BishopPlay Next;
+    static const char PIECE = HORSE;
+
+    static NextPossibleMoves::HorseMoves moves(const ChessBoard &g) {
+        return NextPossibleMoves::for_horse(g);
+    }
+
+    static void move(ChessBoard &g, int row, int col) {
+        g.moveHorse(row, col);
+    }
+};
+
+struct BishopPlay {
+    typedef HorsePlay Next;
+    static const char PIECE = BISHOP;
+
+    static NextPossibleMoves::BishopMoves moves(const ChessBoard &g) {
+        return NextPossibleMoves::for_bishop(g);
+    }
+
+    static void move(ChessBoard &g, int row, int col) {
+        g.moveBishop(row, col);
+    }
+};
+
 // return true if there is better board available
 bool betterBoardExists(long depth, long best, ChessBoard *g) {
     return
@@ -400,48 +705,665 @@ bool betterBoardExists(long depth, long best, ChessBoard *g) {
             best == g->getMinDepth(); // optimum was reached
 }
 
-void bb_dfs_seq(ChessBoard *g, long depth, char play, long &best, ChessBoard *bestBoard, long &counter) {
+#define TRACE_CAPACITY 65536 // events kept per thread, older ones are overwritten
+
+/**
+ * Opt-in timeline of the run (--trace=FILE) in Chrome trace JSON format, open it in ui.perfetto.dev or chrome://tracing.
+ * Each thread records events to its own ring buffer without locking, only the last TRACE_CAPACITY events of each
+ * thread are kept. Until the tracer is started, recording an event costs a single branch.
+ */
+class Tracer {
+public:
+    // span if dur >= 0, instant event otherwise; names are string literals, unused arguments have no name
+    struct Event {
+        const char *name;
+        int64_t start; // [ns] since start()
+        int64_t dur; // [ns]
+        const char *argNames[3];
+        long args[3];
+    };
+
+private:
+    struct Ring {
+        int tid;
+        vector<Event> events;
+        long written; // events[written % TRACE_CAPACITY] is overwritten next
+    };
+
+    static thread_local Ring *ring;
+    bool started = false;
+    chrono::steady_clock::time_point origin;
+    mutex mtx; // guards rings
+    vector<Ring *> rings;
+
+    void record(const Event &e) {
+        if (!ring) {
+            lock_guard<mutex> lock(mtx);
+            ring = new Ring{int(rings.size()), vector<Event>(TRACE_CAPACITY), 0};
+            rings.push_back(ring);
+        }
+        ring->events[ring->written++ % TRACE_CAPACITY] = e;
+    }
+
+public:
+    // called before any other thread records, so started is never written concurrently
+    void start() {
+        origin = chrono::steady_clock::now();
+        started = true;
+    }
+
+    bool isStarted() const {
+        return started;
+    }
+
+    int64_t now() const {
+        return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - origin).count();
+    }
+
+    void instant(const char *name, const char *arg0 = nullptr, long val0 = 0, const char *arg1 = nullptr,
+                 long val1 = 0, const char *arg2 = nullptr, long val2 = 0) {
+        if (started) record(Event{name, now(), -1, {arg0, arg1, arg2}, {val0, val1, val2}});
+    }
+
+    // span from start, as returned by now(), until now
+    void span(const char *name, int64_t start, const char *arg0 = nullptr, long val0 = 0,
+              const char *arg1 = nullptr, long val1 = 0) {
+        if (started) record(Event{name, start, now() - start, {arg0, arg1, nullptr}, {val0, val1, 0}});
+    }
+
+    // recorded events as comma separated trace event objects, pid is the process of the trace they belong to
+    string events(int pid, const string &processName) {
+        lock_guard<mutex> lock(mtx);
+        char buf[256];
+        snprintf(buf, sizeof(buf), "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"args\":{\"name\":\"%s\"}}",
+                 pid, processName.c_str());
+        string out = buf;
+        for (const Ring *r : rings) {
+            long first = max(0L, r->written - TRACE_CAPACITY);
+            if (first > 0) cerr << "Trace: vlákno " << r->tid << " přepsalo " << first << " nejstarších událostí" << endl;
+            for (long i = first; i < r->written; i++) {
+                const Event &e = r->events[i % TRACE_CAPACITY];
+                snprintf(buf, sizeof(buf), ",\n{\"name\":\"%s\",\"ph\":\"%s\",\"pid\":%d,\"tid\":%d,\"ts\":%.3f", e.name,
+                         e.dur < 0 ? "i" : "X", pid, r->tid, e.start / 1000.0);
+                out += buf;
+                if (e.dur < 0) {
+                    out += ",\"s\":\"t\"";
+                } else {
+                    snprintf(buf, sizeof(buf), ",\"dur\":%.3f", e.dur / 1000.0);
+                    out += buf;
+                }
+                out += ",\"args\":{";
+                for (int a = 0; a < 3 && e.argNames[a]; a++) {
+                    snprintf(buf, sizeof(buf), "%s\"%s\":%ld", a ? "," : "", e.argNames[a], e.args[a]);
+                    out += buf;
+                }
+                out += "}}";
+            }
+        }
+        return out;
+    }
+
+    static void write(const string &path, const string &events) {
+        ofstream os(path);
+        os << "{\"traceEvents\":[\n" << events << "\n],\"displayTimeUnit\":\"ms\"}" << endl;
+        if (!os) cerr << "Trace se nepodařilo zapsat do " << path << endl;
+    }
+};
+
+thread_local Tracer::Ring *Tracer::ring = nullptr;
+
+Tracer tracer;
+
+// records its lifetime as a span
+class TraceSpan {
+private:
+    const char *name;
+    int64_t start;
+    const char *argName;
+    long arg;
+
+public:
+    explicit TraceSpan(const char *name, const char *argName = nullptr, long arg = 0) :
+            name(name), start(tracer.isStarted() ? tracer.now() : 0), argName(argName), arg(arg) {}
+
+    ~TraceSpan() {
+        tracer.span(name, start, argName, arg);
+    }
+};
+
+// phases of the run measured by PerfCounters
+enum PerfPhase {
+    PHASE_FRONTIER = 0, // generating instances searched in parallel
+    PHASE_SEARCH = 1,
+    PHASE_SERIALIZATION = 2, // of boards and instances to and from messages
+    PHASE_COMMUNICATION = 3, // inside MPI calls
+    PHASE_CNT = 4
+};
+
+#define PERF_COUNTER_CNT 5
+
+const char *const PERF_PHASE_NAMES[PHASE_CNT] = {"frontier", "search", "serialization", "communication"};
+const char *const PERF_COUNTER_NAMES[PERF_COUNTER_CNT] = {"cycles", "instructions", "l1d_misses", "llc_misses",
+                                                          "branch_misses"};
+
+#ifdef PERF_COUNTERS
+/**
+ * Hardware performance counters of each thread split by phase of the run, built with -DPERF_COUNTERS (Linux only).
+ * Each thread opens its own group of counters by perf_event_open when it first enters a phase. Counts since the
+ * last read are added to the innermost phase the thread is in whenever it enters or leaves a phase, so nested
+ * phases are not counted twice and code outside of all phases is not counted at all.
+ * Counters the machine does not provide (e.g. in a virtual machine) stay 0.
+ */
+class PerfCounters {
+private:
+    struct ThreadCounters {
+        int leader; // fd of the group, -1 if no counter could be opened
+        vector<int> members; // counter of each value read from the group, in order of opening
+        uint64_t last[PERF_COUNTER_CNT];
+        long counts[PHASE_CNT][PERF_COUNTER_CNT];
+        vector<PerfPhase> running;
+    };
+
+    static thread_local ThreadCounters *current;
+    mutex mtx; // guards threads
+    vector<ThreadCounters *> threads;
+    atomic<bool> warned{false};
+
+    static int open(uint32_t type, uint64_t config, int groupFd) {
+        perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = type;
+        attr.config = config;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_GROUP;
+        return syscall(__NR_perf_event_open, &attr, 0, -1, groupFd, 0);
+    }
+
+    ThreadCounters *thread() {
+        if (current) return current;
+        const uint64_t events[PERF_COUNTER_CNT][2] = {
+                {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+                {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+                {PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                                     (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)},
+                {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+                {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+        };
+        current = new ThreadCounters();
+        current->leader = -1;
+        for (int c = 0; c < PERF_COUNTER_CNT; c++) {
+            int fd = open(events[c][0], events[c][1], current->leader);
+            if (fd < 0) continue;
+            if (current->leader < 0) current->leader = fd;
+            current->members.push_back(c);
+        }
+        if (current->leader < 0 && !warned.exchange(true)) {
+            cerr << "Hardwarové čítače nejsou dostupné (perf_event_open: " << strerror(errno) << ")" << endl;
+        }
+        lock_guard<mutex> lock(mtx);
+        threads.push_back(current);
+        return current;
+    }
+
+    // adds counts since the last read to the innermost running phase
+    static void account(ThreadCounters *t) {
+        struct {
+            uint64_t nr;
+            uint64_t values[PERF_COUNTER_CNT];
+        } group;
+        if (read(t->leader, &group, sizeof(group)) < 0) return;
+        for (uint64_t i = 0; i < group.nr && i < t->members.size(); i++) {
+            int c = t->members[i];
+            if (!t->running.empty()) t->counts[t->running.back()][c] += group.values[i] - t->last[c];
+            t->last[c] = group.values[i];
+        }
+    }
+
+public:
+    void begin(PerfPhase phase) {
+        ThreadCounters *t = thread();
+        if (t->leader < 0) return;
+        account(t);
+        t->running.push_back(phase);
+    }
+
+    void end() {
+        ThreadCounters *t = current;
+        if (!t || t->leader < 0) return;
+        account(t);
+        t->running.pop_back();
+    }
+
+    // counts of all threads that have entered a phase, PHASE_CNT * PERF_COUNTER_CNT per thread, then sets them to 0;
+    // called while no other thread is in a phase
+    vector<long> take() {
+        lock_guard<mutex> lock(mtx);
+        vector<long> all;
+        for (ThreadCounters *t : threads) {
+            all.insert(all.end(), &t->counts[0][0], &t->counts[0][0] + PHASE_CNT * PERF_COUNTER_CNT);
+            memset(t->counts, 0, sizeof(t->counts));
+        }
+        return all;
+    }
+};
+
+thread_local PerfCounters::ThreadCounters *PerfCounters::current = nullptr;
+
+PerfCounters perfCounters;
+#endif
+
+// counts hardware events of its lifetime to the phase, does nothing without -DPERF_COUNTERS
+class PerfScope {
+public:
+    explicit PerfScope(PerfPhase phase) {
+#ifdef PERF_COUNTERS
+        perfCounters.begin(phase);
+#else
+        (void) phase;
+#endif
+    }
+
+    ~PerfScope() {
+#ifdef PERF_COUNTERS
+        perfCounters.end();
+#endif
+    }
+};
+
+/**
+ * Machine-readable summary of a run for the analysis pipeline, see --report.
+ * Appended to the report file as one JSON object per line, or as one CSV row if the file name ends with .csv
+ * (with header when the file is empty). Fields keep the order in which they were added.
+ */
+class RunReport {
+private:
+    vector<string> names;
+    vector<string> jsonValues;
+    vector<string> csvValues;
+
+    static string jsonQuote(const string &s) {
+        string quoted = "\"";
+        for (char c : s) {
+            if (c == '"' || c == '\\') quoted += '\\';
+            quoted += c;
+        }
+        return quoted + "\"";
+    }
+
+    static string csvQuote(const string &s) {
+        string quoted = "\"";
+        for (char c : s) {
+            if (c == '"') quoted += '"';
+            quoted += c;
+        }
+        return quoted + "\"";
+    }
+
+    void add(const string &name, const string &jsonValue, const string &csvValue) {
+        names.push_back(name);
+        jsonValues.push_back(jsonValue);
+        csvValues.push_back(csvValue);
+    }
+
+public:
+    void addCount(const string &name, long value) {
+        add(name, to_string(value), to_string(value));
+    }
+
+    // real value with 3 decimal places, times are in milliseconds
+    void addTime(const string &name, double value) {
+        char buf[32];
+        snprintf(buf, sizeof(buf), "%.3f", value);
+        add(name, buf, buf);
+    }
+
+    void addText(const string &name, const string &value) {
+        add(name, jsonQuote(value), csvQuote(value));
+    }
+
+    // items as printed by operator<<, JSON array of strings, in CSV joined by ';'
+    template<class T>
+    void addList(const string &name, const vector<T> &items) {
+        string json = "[", csv;
+        for (size_t i = 0; i < items.size(); i++) {
+            ostringstream item;
+            item << items[i];
+            json += (i ? ", " : "") + jsonQuote(item.str());
+            csv += (i ? ";" : "") + item.str();
+        }
+        add(name, json + "]", csvQuote(csv));
+    }
+
+    // JSON array of numbers, in CSV joined by ';'
+    void addCountList(const string &name, const vector<long> &values) {
+        string json = "[", csv;
+        for (size_t i = 0; i < values.size(); i++) {
+            json += (i ? ", " : "") + to_string(values[i]);
+            csv += (i ? ";" : "") + to_string(values[i]);
+        }
+        add(name, json + "]", csvQuote(csv));
+    }
+
+    void append(const string &path) const {
+        bool csv = path.size() > 4 && path.compare(path.size() - 4, 4, ".csv") == 0;
+        ifstream existing(path);
+        bool empty = existing.peek() == ifstream::traits_type::eof();
+        existing.close();
+
+        ofstream os(path, ios::app);
+        if (csv) {
+            if (empty) {
+                for (size_t i = 0; i < names.size(); i++) os << (i ? "," : "") << names[i];
+                os << endl;
+            }
+            for (size_t i = 0; i < csvValues.size(); i++) os << (i ? "," : "") << csvValues[i];
+            os << endl;
+        } else {
+            os << "{";
+            for (size_t i = 0; i < names.size(); i++) {
+                os << (i ? ", " : "") << jsonQuote(names[i]) << ": " << jsonValues[i];
+            }
+            os << "}" << endl;
+        }
+        if (!os) cerr << "Report se nepodařilo zapsat do " << path << endl;
+    }
+};
+
+#ifdef PROFILE_TREE
+#define PROFILE(statement) statement
+#define PROFILE_MAX_DEPTH 128 // deeper nodes are counted in the last level of the profile
+#else
+#define PROFILE(statement)
+#endif
+
+/**
+ * Counters of one search, shared by all its threads.
+ * Pruned nodes are split by the first condition of betterBoardExists that cut them off.
+ * Profiling build (-DPROFILE_TREE) keeps the counters also per depth of the search tree, see printProfile.
+ */
+struct SearchStats {
+    long nodes = 0;
+    long prunedBound = 0;
+    long prunedMaxDepth = 0;
+    long prunedOptimum = 0;
+#ifdef PROFILE_TREE
+    struct Level {
+        long entered = 0;
+        long expanded = 0; // nodes whose moves were generated
+        long children = 0;
+        long prunedBound = 0;
+        long prunedMaxDepth = 0;
+        long prunedOptimum = 0;
+        long solutions = 0; // leaves without pawns, improving the best solution or not
+    };
+    Level levels[PROFILE_MAX_DEPTH];
+
+    Level &level(long depth) {
+        return levels[min(depth, long(PROFILE_MAX_DEPTH - 1))];
+    }
+
+    static string branching(long children, long expanded) {
+        char buf[32];
+        snprintf(buf, sizeof(buf), "%.2f", expanded ? double(children) / expanded : 0.0);
+        return buf;
+    }
+
+    // one row per depth, play is the piece moved from nodes of that depth (bishop moves first),
+    // levels expanded while generating the initial frontier are not searched by the kernel and stay empty
+    static void printLevels(ostream &os, const Level *levels) {
+        os << "Profil stromu prohledávání" << endl;
+        os << "Hloubka\tTah\tUzly\tRozvinuto\tVětvení\tOřez mez\tOřez maxDepth\tOřez optimum\tŘešení" << endl;
+        long expanded[2] = {0, 0}, children[2] = {0, 0}; // bishop, horse plies
+        for (int d = 0; d < PROFILE_MAX_DEPTH; d++) {
+            const Level &l = levels[d];
+            if (l.entered == 0) continue;
+            expanded[d % 2] += l.expanded;
+            children[d % 2] += l.children;
+            os << d << "\t" << (d % 2 ? HORSE : BISHOP) << "\t" << l.entered << "\t" << l.expanded << "\t\t"
+               << branching(l.children, l.expanded) << "\t" << l.prunedBound << "\t\t" << l.prunedMaxDepth
+               << "\t\t" << l.prunedOptimum << "\t\t" << l.solutions << endl;
+        }
+        os << "Průměrné větvení: " << BISHOP << " " << branching(children[0], expanded[0]) << ", " << HORSE << " "
+           << branching(children[1], expanded[1]) << endl << endl;
+    }
+
+    // columns of the profile as lists indexed by depth, up to the deepest level entered
+    static void addLevelsTo(RunReport &report, const Level *levels) {
+        int depths = PROFILE_MAX_DEPTH;
+        while (depths > 0 && levels[depths - 1].entered == 0) depths--;
+        const pair<const char *, long Level::*> columns[] = {
+                {"depth_nodes", &Level::entered},
+                {"depth_expanded", &Level::expanded},
+                {"depth_children", &Level::children},
+                {"depth_pruned_bound", &Level::prunedBound},
+                {"depth_pruned_max_depth", &Level::prunedMaxDepth},
+                {"depth_pruned_optimum", &Level::prunedOptimum},
+                {"depth_solutions", &Level::solutions},
+        };
+        for (const auto &column : columns) {
+            vector<long> values;
+            for (int d = 0; d < depths; d++) values.push_back(levels[d].*column.second);
+            report.addCountList(column.first, values);
+        }
+    }
+#endif
+
+    static void add(long &counter, long n = 1) {
+#pragma omp atomic update
+        counter += n;
+    }
+
+    void entered(long depth) {
+        PROFILE(add(level(depth).entered));
+    }
+
+    void expanded(long depth, long children) {
+        PROFILE(add(level(depth).expanded));
+        PROFILE(add(level(depth).children, children));
+    }
+
+    void solved(long depth) {
+        PROFILE(add(level(depth).solutions));
+    }
+
+    void pruned(long depth, long best, ChessBoard *g) {
+        if (depth + g->getPawnCnt() >= best) {
+            add(prunedBound);
+            PROFILE(add(level(depth).prunedBound));
+        } else if (depth + g->getPawnCnt() > g->getMaxDepth()) {
+            add(prunedMaxDepth);
+            PROFILE(add(level(depth).prunedMaxDepth));
+        } else {
+            add(prunedOptimum);
+            PROFILE(add(level(depth).prunedOptimum));
+        }
+    }
+
+    void addTo(RunReport &report) const {
+        report.addCount("nodes", nodes);
+        report.addCount("pruned_bound", prunedBound);
+        report.addCount("pruned_max_depth", prunedMaxDepth);
+        report.addCount("pruned_optimum", prunedOptimum);
+        PROFILE(addLevelsTo(report, levels));
+    }
+
+    // prints nothing unless built with -DPROFILE_TREE
+    void printProfile(ostream &os) const {
+        PROFILE(printLevels(os, levels));
+    }
+};
+
+#define NO_TIME_LIMIT 0
+
+// anytime mode, search stops at wall-clock deadline read by every node, so none is expanded after it
+class Deadline {
+private:
+    chrono::steady_clock::time_point start;
+    chrono::steady_clock::time_point end;
+    double limit; // [s]
+    mutable atomic<bool> expired;
+    atomic<bool> finished;
+    long open_bound; // lowest lower bound (depth + pawn count) of nodes left unexplored because of the deadline
+
+public:
+    explicit Deadline(double limit) : start(chrono::steady_clock::now()), limit(limit), expired(false),
+                                      finished(false), open_bound(numeric_limits<long>::max()) {
+        end = start + chrono::duration_cast<chrono::steady_clock::duration>(chrono::duration<double>(limit));
+    }
+
+    // once expired stays expired, after finish the search is not cut any more
+    bool isExpired() const {
+        if (expired.load(memory_order_relaxed)) return true;
+        if (limit == NO_TIME_LIMIT || finished.load(memory_order_relaxed)) return false;
+        if (chrono::steady_clock::now() < end) return false;
+        expired = true;
+        return true;
+    }
+
+    void leaveOpen(long bound) {
+#pragma omp critical(open_bound)
+        open_bound = min(open_bound, bound);
+    }
+
+    // called from the critical section updating the best solution, streams time-to-quality in anytime mode
+    void improved(long best) {
+        if (limit == NO_TIME_LIMIT || isExpired()) return;
+        cout << "Zlepšení: cena " << best << " po "
+             << chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - start).count() << " ms"
+             << endl;
+    }
+
+    void finish() {
+        finished = true;
+    }
+
+    // lower bound on the optimum is the lowest one of the best solution and of the unexplored nodes
+    void report(long best) {
+        if (!isExpired()) return;
+        long lower = min(best, open_bound);
+        cout << "Časový limit " << limit << " s vypršel" << endl;
+        cout << "Dolní mez ceny: " << lower << endl;
+        if (best == numeric_limits<long>::max()) {
+            cout << "Mezera optimality: řešení nenalezeno" << endl << endl;
+        } else {
+            ostringstream gap;
+            gap << fixed << setprecision(1) << 100.0 * (best - lower) / best;
+            cout << "Mezera optimality: " << best - lower << " (" << gap.str() << " %)" << endl << endl;
+        }
+    }
+};
+
+// position of DFS inside of its instance, index of child searched at each of first CHECKPOINT_DEPTH levels
+// search resumed from this position repeats only subtree below CHECKPOINT_DEPTH
+struct DfsProgress {
+    omp_lock_t lock;
+    long instance = -1; // index of searched instance, -1 if idle
+    int path[CHECKPOINT_DEPTH];
+    int path_len = 0;
+
+    DfsProgress() {
+        omp_init_lock(&lock);
+    }
+
+    ~DfsProgress() {
+        omp_destroy_lock(&lock);
+    }
+
+    void start(long ins, const vector<int> &resume_path) {
+        omp_set_lock(&lock);
+        instance = ins;
+        path_len = min((int) resume_path.size(), CHECKPOINT_DEPTH);
+        copy(resume_path.begin(), resume_path.begin() + path_len, path);
+        omp_unset_lock(&lock);
+    }
+
+    void enter(int level, int child) {
+        if (level >= CHECKPOINT_DEPTH) return;
+        omp_set_lock(&lock);
+        path[level] = child;
+        path_len = level + 1;
+        omp_unset_lock(&lock);
+    }
+
+    void finish() {
+        omp_set_lock(&lock);
+        instance = -1;
+        path_len = 0;
+        omp_unset_lock(&lock);
+    }
+
+    long snapshot(vector<int> &out) {
+        omp_set_lock(&lock);
+        long ins = instance;
+        out.assign(path, path + path_len);
+        omp_unset_lock(&lock);
+        return ins;
+    }
+};
+
+// resume is position of DFS saved to checkpoint, children before it were already searched
+template<class Play>
+void bb_dfs_seq(ChessBoard *g, long depth, long &best, ChessBoard *bestBoard, SearchStats &stats,
+                Deadline &deadline, DfsProgress *progress, int level, const int *resume, int resume_len) {
+    stats.entered(depth);
     if (!betterBoardExists(depth, best, g)) {
-        if (g->getPawnCnt() == 0) {
+        if (deadline.isExpired()) {
+            deadline.leaveOpen(depth + g->getPawnCnt());
+        } else if (g->getPawnCnt() == 0) {
+            stats.solved(depth);
 #pragma omp critical
             {
                 if (!betterBoardExists(depth, best, g)) {
                     best = depth;
                     *bestBoard = *g;
+                    deadline.improved(best);
+                    tracer.instant("incumbent", "cost", best);
                 }
             }
-        } else if (play == HORSE) {
-            for (const auto &m : NextPossibleMoves::for_horse(*g)) {
-                ChessBoard *cpy = new ChessBoard(*g);
-                cpy->moveHorse(m.row, m.col);
-                bb_dfs_seq(cpy, depth + 1, BISHOP, best, bestBoard, counter);
-            }
-        } else if (play == BISHOP) {
-            for (const auto &m : NextPossibleMoves::for_bishop(*g)) {
-                ChessBoard *cpy = new ChessBoard(*g);
-                cpy->moveBishop(m.row, m.col);
-                bb_dfs_seq(cpy, depth + 1, HORSE, best, bestBoard, counter);
+        } else {
+            auto moves = Play::moves(*g);
+            stats.expanded(depth, moves.size());
+            for (int i = resume_len ? resume[0] : 0; i < (int) moves.size(); i++) {
+                if (progress) progress->enter(level, i);
+                bool resumed = resume_len && i == resume[0];
+                ChessBoard cpy = *g;
+                Play::move(cpy, moves[i].row, moves[i].col);
+                bb_dfs_seq<typename Play::Next>(&cpy, depth + 1, best, bestBoard, stats, deadline, progress,
+                                                level + 1, resumed ? resume + 1 : nullptr,
+                                                resumed ? resume_len - 1 : 0);
             }
         }
+    } else {
+        stats.pruned(depth, best, g);
     }
-    delete g;
 #pragma omp atomic update
-    counter++;
+    stats.nodes++;
 }
 
+// search of a board whose side to move play is known only at run time
+void bb_dfs_seq(ChessBoard *g, long depth, char play, long &best, ChessBoard *bestBoard, SearchStats &stats,
+                Deadline &deadline, DfsProgress *progress = nullptr, int level = 0, const int *resume = nullptr,
+                int resume_len = 0) {
+    if (play == HORSE) {
+        bb_dfs_seq<HorsePlay>(g, depth, best, bestBoard, stats, deadline, progress, level, resume, resume_len);
+    } else {
+        bb_dfs_seq<BishopPlay>(g, depth, best, bestBoard, stats, deadline, progress, level, resume, resume_len);
+    }
+}
+
+// boards of the frontier are stored in the vector of instances, one contiguous array
 struct Instance {
-    ChessBoard *board;
+    ChessBoard board;
     int depth;
     char play;
+    vector<int> resume_path; // position of DFS restored from checkpoint
 
-    void freeMem() const {
-        delete board;
-    }
-
-    Instance(ChessBoard *board, int depth, char play) : board(board), depth(depth), play(play) {}
+    Instance(const ChessBoard &board, int depth, char play) : board(board), depth(depth), play(play) {}
 };
 
-vector<Instance> generateInstances(ChessBoard *initBoard, int initDepth, char initPlay) {
+vector<Instance> generateInstances(const ChessBoard &initBoard, int initDepth, char initPlay) {
     vector<Instance> instances = vector<Instance>();
     instances.emplace_back(initBoard, initDepth, initPlay);
 
@@ -449,57 +1371,474 @@ vector<Instance> generateInstances(ChessBoard *initBoard, int initDepth, char in
         vector<Instance> instancesNext = vector<Instance>();
         for (const auto &ins : instances) {
             if (ins.play == HORSE) {
-                for (const auto &m : NextPossibleMoves::for_horse(*ins.board)) {
-                    ChessBoard *cpy = new ChessBoard(*ins.board);
-                    cpy->moveHorse(m.row, m.col);
-                    instancesNext.emplace_back(cpy, ins.depth + 1, BISHOP);
+                for (const auto &m : NextPossibleMoves::for_horse(ins.board)) {
+                    instancesNext.emplace_back(ins.board, ins.depth + 1, BISHOP);
+                    instancesNext.back().board.moveHorse(m.row, m.col);
                 }
             } else if (ins.play == BISHOP) {
-                for (const auto &m : NextPossibleMoves::for_bishop(*ins.board)) {
-                    ChessBoard *cpy = new ChessBoard(*ins.board);
-                    cpy->moveBishop(m.row, m.col);
-                    instancesNext.emplace_back(cpy, ins.depth + 1, HORSE);
+                for (const auto &m : NextPossibleMoves::for_bishop(ins.board)) {
+                    instancesNext.emplace_back(ins.board, ins.depth + 1, HORSE);
+                    instancesNext.back().board.moveBishop(m.row, m.col);
                 }
             }
-            ins.freeMem();
         }
-        instances = instancesNext;
+        instances.swap(instancesNext);
     }
     cout << "Vygenerováno " << instances.size() << " instancí pro počet epoch " << EPOCH_CNT << "." << endl << endl;
     return instances;
 }
 
-void bb_dfs_data_par(ChessBoard *g, long &best, ChessBoard *bestBoard, long &counter) {
-    vector<Instance> instances = generateInstances(g, 0, BISHOP);
+// moves of board in checkpoint format "count row col row col ..."
+string checkpoint_moves(const ChessBoard &g) {
+    ostringstream os;
+    os << g.getMoveLog().size();
+    for (const auto &m : g.getMoveLog()) {
+        os << " " << m.getRow() << " " << m.getCol();
+    }
+    return os.str();
+}
+
+// replay moves in checkpoint format on initial board, bishop plays first
+// false if there are more moves than max depth of the instance or a move is off the board
+bool checkpoint_replay(const ChessBoard &init, istream &is, ChessBoard &g) {
+    g = init;
+    int cnt = -1, row, col;
+    is >> cnt;
+    if (cnt < 0 || cnt > init.getMaxDepth()) return false;
+    for (int i = 0; i < cnt; i++) {
+        if (!(is >> row >> col) || row < 0 || col < 0 || row >= init.getRowLen() || col >= init.getRowLen()) {
+            return false;
+        }
+        if (i % 2 == 0) g.moveBishop(row, col);
+        else g.moveHorse(row, col);
+    }
+    return true;
+}
+
+// periodically saved state of search: best solution, unfinished instances and position of DFS in running ones
+class Checkpoint {
+private:
+    string path;
+    int period;
+    const vector<Instance> &instances;
+    vector<string> instance_moves;
+    vector<char> done;
+    vector<DfsProgress> progress;
+    long &best;
+    ChessBoard *bestBoard;
+    const Deadline &deadline;
+    string instance_hash; // of the initial board, checkpoint of another instance is not loaded
+
+    thread writer;
+    mutex mtx;
+    condition_variable cv;
+    bool stopped = false;
+
+    void write() {
+        // progress is read before done flags and best solution, so nothing finished in between is lost
+        vector<long> running(progress.size());
+        vector<vector<int>> paths(progress.size());
+        for (unsigned long t = 0; t < progress.size(); t++) {
+            running[t] = progress[t].snapshot(paths[t]);
+        }
+        vector<char> pending(done.size());
+        for (unsigned long i = 0; i < done.size(); i++) {
+            char d;
+#pragma omp atomic read
+            d = done[i];
+            pending[i] = !d;
+        }
+        long best_cost;
+        string best_moves;
+#pragma omp critical
+        {
+            best_cost = best;
+            best_moves = checkpoint_moves(*bestBoard);
+        }
+        // instances cut by the deadline end as if they were finished, checkpoint is kept as it was before
+        if (deadline.isExpired()) return;
+
+        ofstream ofs(path + ".tmp");
+        ofs << "PDP-CHECKPOINT 2 " << instance_hash << endl;
+        ofs << "best " << best_cost << " " << best_moves << endl;
+        for (unsigned long t = 0; t < progress.size(); t++) {
+            if (running[t] < 0 || !pending[running[t]]) continue;
+            pending[running[t]] = false;
+            ofs << "instance " << instance_moves[running[t]] << " " << paths[t].size();
+            for (int child : paths[t]) ofs << " " << child;
+            ofs << endl;
+        }
+        for (unsigned long i = 0; i < pending.size(); i++) {
+            if (!pending[i]) continue;
+            ofs << "instance " << instance_moves[i] << " " << instances[i].resume_path.size();
+            for (int child : instances[i].resume_path) ofs << " " << child;
+            ofs << endl;
+        }
+        ofs.close();
+        rename((path + ".tmp").c_str(), path.c_str());
+    }
+
+public:
+    Checkpoint(const string &path, int period, const vector<Instance> &instances, long &best, ChessBoard *bestBoard,
+               const Deadline &deadline, const string &instance_hash)
+            : path(path), period(period), instances(instances), done(instances.size(), 0), progress({PROCNUM}),
+              best(best), bestBoard(bestBoard), deadline(deadline), instance_hash(instance_hash) {
+        if (!enabled()) return;
+        for (const auto &ins : instances) {
+            instance_moves.push_back(checkpoint_moves(ins.board));
+        }
+        writer = thread([this] {
+            unique_lock<mutex> lock(mtx);
+            while (!cv.wait_for(lock, chrono::seconds(this->period), [this] { return stopped; })) {
+                write();
+            }
+        });
+    }
+
+    bool enabled() const {
+        return !path.empty();
+    }
+
+    DfsProgress *begin(long i) {
+        if (!enabled()) return nullptr;
+        DfsProgress &p = progress[omp_get_thread_num()];
+        p.start(i, instances[i].resume_path);
+        return &p;
+    }
+
+    void end(long i) {
+        if (!enabled()) return;
+#pragma omp atomic write
+        done[i] = 1;
+        progress[omp_get_thread_num()].finish();
+    }
+
+    // search finished, checkpoint is no longer needed unless the search was stopped by the deadline
+    void stop() {
+        if (!enabled()) return;
+        {
+            lock_guard<mutex> lock(mtx);
+            stopped = true;
+        }
+        cv.notify_all();
+        writer.join();
+        if (!deadline.isExpired()) remove(path.c_str());
+    }
+
+    // false if there is no checkpoint of init, checkpoint of another instance or a damaged one is ignored
+    static bool load(const string &path, const ChessBoard &init, vector<Instance> &instances, long &best,
+                     ChessBoard *bestBoard) {
+        ifstream ifs(path);
+        string tag, hash;
+        int version;
+        if (!(ifs >> tag >> version >> hash) || tag != "PDP-CHECKPOINT" || version != 2) return false;
+        if (hash != init.hash()) {
+            cerr << "Checkpoint " << path << " patří jiné instanci, hledání začne znovu." << endl;
+            return false;
+        }
+
+        long cost;
+        ChessBoard g;
+        vector<Instance> restored;
+        bool valid = ifs >> tag >> cost && checkpoint_replay(init, ifs, g);
+        while (valid && ifs >> tag && tag == "instance") {
+            ChessBoard board;
+            int cnt = -1;
+            valid = checkpoint_replay(init, ifs, board) && ifs >> cnt && cnt >= 0 && cnt <= init.getMaxDepth();
+            if (!valid) break;
+            int depth = board.getMoveCnt();
+            restored.emplace_back(board, depth, depth % 2 ? HORSE : BISHOP);
+            restored.back().resume_path.resize(cnt);
+            for (int &child : restored.back().resume_path) ifs >> child;
+        }
+        if (!valid) {
+            cerr << "Checkpoint " << path << " je poškozený, hledání začne znovu." << endl;
+            return false;
+        }
+
+        if (cost < best) {
+            best = cost;
+            *bestBoard = g;
+        }
+        instances = restored;
+        return true;
+    }
+};
+
+// frontier_ms is set to time spent generating (or restoring) the instances searched in parallel
+void bb_dfs_data_par(const ChessBoard &g, long &best, ChessBoard *bestBoard, SearchStats &stats, Deadline &deadline,
+                     const string &checkpoint_path, int checkpoint_period, double &frontier_ms) {
+    auto frontier_start = chrono::high_resolution_clock::now();
+    int64_t trace_start = tracer.now();
+    vector<Instance> instances;
+    if (!checkpoint_path.empty() && Checkpoint::load(checkpoint_path, g, instances, best, bestBoard)) {
+        cout << "Obnoveno " << instances.size() << " nedokončených instancí z " << checkpoint_path << "." << endl
+             << endl;
+    } else {
+        PerfScope perf(PHASE_FRONTIER);
+        instances = generateInstances(g, 0, BISHOP);
+    }
+    frontier_ms = chrono::duration<double, milli>(chrono::high_resolution_clock::now() - frontier_start).count();
+    tracer.span("frontier", trace_start, "instances", instances.size());
+    Checkpoint checkpoint(checkpoint_path, checkpoint_period, instances, best, bestBoard, deadline, g.hash());
 	omp_set_num_threads({PROCNUM}); // CHANGE
-#pragma omp parallel for shared(best, bestBoard, counter, instances) schedule(dynamic) default(none)
+#pragma omp parallel for shared(best, bestBoard, stats, deadline, instances, checkpoint) schedule(dynamic) default(none)
     for (unsigned long i = 0; i < instances.size(); i++) {
-        bb_dfs_seq(instances[i].board, instances[i].depth, instances[i].play, best, bestBoard, counter);
+        TraceSpan span("instance", "index", i);
+        PerfScope perf(PHASE_SEARCH);
+        DfsProgress *progress = checkpoint.begin(i);
+        const vector<int> &resume = instances[i].resume_path;
+        bb_dfs_seq(&instances[i].board, instances[i].depth, instances[i].play, best, bestBoard, stats, deadline,
+                   progress, 0, resume.data(), int(resume.size()));
+        checkpoint.end(i);
     }
+    checkpoint.stop();
 }
 
-int main(int argc, char **argv) {
+// instance files given on command line, directory stands for all *.txt files in it
+bool has_suffix(const string &name, const string &suffix) {
+    return name.size() > suffix.size() && name.compare(name.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
 
+// pack is expanded to all its instances "pack#0", "pack#1", ...
+void add_instance_file(const string &path, vector<string> &files) {
+    const InstancePack *pack = path.find('#') == string::npos ? InstancePack::open(path) : nullptr;
+    if (!pack) {
+        files.push_back(path);
+        return;
+    }
+    for (uint32_t i = 0; i < pack->count(); i++) files.push_back(path + "#" + to_string(i));
+}
+
+void add_instance_files(const string &path, vector<string> &files) {
+    DIR *dir = opendir(path.c_str());
+    if (!dir) {
+        add_instance_file(path, files);
+        return;
+    }
+    vector<string> found;
+    while (dirent *entry = readdir(dir)) {
+        string name = entry->d_name;
+        if (has_suffix(name, ".txt") || has_suffix(name, ".sajb")) found.push_back(path + "/" + name);
+    }
+    closedir(dir);
+    sort(found.begin(), found.end());
+    for (const string &file : found) add_instance_file(file, files);
+}
+
+// one instance of a batch, searched with its own incumbent by the thread pool shared by the whole batch
+struct BatchItem {
+    string filename;
+    long best = numeric_limits<long>::max();
+    ChessBoard bestBoard;
+    SearchStats stats;
+    string hash; // of the instance as loaded
+    double load_ms = 0;
+    double frontier_ms = 0;
+    long pending = 0; // frontier instances of this instance not finished yet
+    chrono::high_resolution_clock::time_point finish;
+
+    explicit BatchItem(const string &filename) : filename(filename), bestBoard(filename), hash(bestBoard.hash()),
+                                                 finish(chrono::high_resolution_clock::now()) {}
+
+    void spawned() {
+#pragma omp atomic update
+        pending++;
+    }
+
+    // the last one to finish records completion time of the instance
+    void finished() {
+        long left;
+#pragma omp atomic capture
+        left = --pending;
+        if (left == 0) finish = chrono::high_resolution_clock::now();
+    }
+};
+
+// fields perf_<phase>_<counter> summed over threads and perf_<phase>_<counter>_by_thread, counts hold
+// PHASE_CNT * PERF_COUNTER_CNT values for each of threads; phases no thread has counted in are left out
+void add_perf_counts(RunReport &report, const vector<long> &counts, const vector<string> &threads) {
+    const int perThread = PHASE_CNT * PERF_COUNTER_CNT;
+    bool threadsAdded = false;
+    for (int p = 0; p < PHASE_CNT; p++) {
+        bool counted = false;
+        for (size_t i = 0; i < counts.size(); i++) counted |= int(i % perThread) / PERF_COUNTER_CNT == p && counts[i];
+        if (!counted) continue;
+        if (!threadsAdded) report.addList("perf_threads", threads);
+        threadsAdded = true;
+        for (int c = 0; c < PERF_COUNTER_CNT; c++) {
+            string name = string("perf_") + PERF_PHASE_NAMES[p] + "_" + PERF_COUNTER_NAMES[c];
+            long total = 0;
+            vector<long> byThread;
+            for (size_t t = 0; t < threads.size(); t++) {
+                byThread.push_back(counts[t * perThread + p * PERF_COUNTER_CNT + c]);
+                total += byThread.back();
+            }
+            report.addCount(name, total);
+            report.addCountList(name + "_by_thread", byThread);
+        }
+    }
+}
+
+// appends report of one solved instance to path, cost is -1 if no solution was found
+void append_report(const string &path, const string &filename, const string &hash, long best,
+                   const ChessBoard &bestBoard, const SearchStats &stats, double load_ms, double frontier_ms,
+                   double search_ms) {
+    RunReport report;
+    report.addText("engine", "openmp-data");
+    report.addCount("threads", {PROCNUM});
+    report.addCount("ranks", 1);
+    report.addText("instance", filename);
+    report.addText("instance_hash", hash);
+    report.addCount("cost", best == numeric_limits<long>::max() ? -1 : best);
+    stats.addTo(report);
+    report.addTime("load_ms", load_ms);
+    report.addTime("frontier_ms", frontier_ms);
+    report.addTime("search_ms", search_ms);
+    report.addTime("comm_ms", 0);
+    report.addList("moves", bestBoard.getMoveLog());
+#ifdef PERF_COUNTERS
+    vector<long> counts = perfCounters.take();
+    vector<string> threads;
+    for (size_t t = 0; t < counts.size() / (PHASE_CNT * PERF_COUNTER_CNT); t++) threads.push_back(to_string(t));
+    add_perf_counts(report, counts, threads);
+#endif
+    report.append(path);
+}
+
+// per-instance latency is measured from the start of the batch
+void print_batch_report(const vector<BatchItem> &items, chrono::high_resolution_clock::time_point start,
+                        chrono::high_resolution_clock::time_point stop) {
+    cout << "Instance\tCena\tPočet volání\tLatence [ms]" << endl;
+    for (const auto &item : items) {
+        // instance without a solution within its max depth has cost -1, as in the JSON report
+        long cost = item.best == numeric_limits<long>::max() ? -1 : item.best;
+        cout << item.filename.substr(item.filename.find_last_of('/') + 1) << "\t" << cost << "\t"
+             << item.stats.nodes << "\t\t"
+             << chrono::duration_cast<chrono::milliseconds>(item.finish - start).count() << endl;
+    }
+    long total = chrono::duration_cast<chrono::milliseconds>(stop - start).count();
+    cout << endl;
+    cout << "Počet instancí: " << items.size() << endl;
+    cout << "Celkový čas [ms]: " << total << endl;
+    cout << "Propustnost [instancí/s]: " << (total > 0 ? 1000.0 * items.size() / total : 0) << endl;
+}
+
+// frontiers of all instances are searched by one parallel loop, idle threads take instances of the next file
+void solve_batch(const vector<string> &files, const string &report_path) {
+    vector<BatchItem> items;
+    items.reserve(files.size());
+    for (const auto &filename : files) {
+        auto load_start = chrono::high_resolution_clock::now();
+        items.emplace_back(filename);
+        items.back().load_ms = chrono::duration<double, milli>(chrono::high_resolution_clock::now() - load_start)
+                .count();
+    }
+    Deadline deadline(NO_TIME_LIMIT);
+
+    auto start = chrono::high_resolution_clock::now();
+    vector<Instance> instances;
+    vector<int> owner;
+    for (unsigned long k = 0; k < items.size(); k++) {
+        auto frontier_start = chrono::high_resolution_clock::now();
+        for (const auto &ins : generateInstances(items[k].bestBoard, 0, BISHOP)) {
+            instances.push_back(ins);
+            owner.push_back(k);
+            items[k].spawned();
+        }
+        items[k].frontier_ms = chrono::duration<double, milli>(chrono::high_resolution_clock::now() - frontier_start)
+                .count();
+    }
+	omp_set_num_threads({PROCNUM});
+#pragma omp parallel for shared(items, instances, owner, deadline) schedule(dynamic) default(none)
+    for (unsigned long i = 0; i < instances.size(); i++) {
+        TraceSpan span("instance", "index", i);
+        BatchItem &item = items[owner[i]];
+        bb_dfs_seq(&instances[i].board, instances[i].depth, instances[i].play, item.best, &item.bestBoard,
+                   item.stats, deadline);
+        item.finished();
+    }
+    auto stop = chrono::high_resolution_clock::now();
+    print_batch_report(items, start, stop);
+    if (report_path.empty()) return;
+    for (const auto &item : items) {
+        append_report(report_path, item.filename, item.hash, item.best, item.bestBoard, item.stats, item.load_ms,
+                      item.frontier_ms, chrono::duration<double, milli>(item.finish - start).count());
+    }
+}
+
+// usage: [--checkpoint-dir=DIR] [--checkpoint-period=SECONDS] [--time-limit=SECONDS] [--batch] [--report=FILE]
+//        instance_file_or_directory...
+// with checkpoint directory the search state is saved periodically and an interrupted run resumes from it
+// with time limit the search stops at the deadline and reports the best solution found and its optimality gap
+// in batch mode all instances share one thread pool, latency of each instance and throughput are reported
+// binary pack (tools/saj2bin.py) stands for all its instances, "pack.sajb#i" selects only the i-th one
+// with report file a summary of each solved instance is appended to it, see RunReport
+// with trace file a timeline of the run is written to it at exit, see Tracer
+int main(int argc, char **argv) {
+    string checkpoint_dir;
+    int checkpoint_period = CHECKPOINT_PERIOD;
+    double time_limit = NO_TIME_LIMIT;
+    bool batch = false;
+    string report_path, trace_path;
+    vector<string> files;
     for (int i = 1; i < argc; i++) {
-        string filename = argv[i];
+        string arg = argv[i];
+        if (arg.compare(0, 17, "--checkpoint-dir=") == 0) checkpoint_dir = arg.substr(17);
+        else if (arg.compare(0, 20, "--checkpoint-period=") == 0) checkpoint_period = stoi(arg.substr(20));
+        else if (arg.compare(0, 13, "--time-limit=") == 0) time_limit = stod(arg.substr(13));
+        else if (arg == "--batch") batch = true;
+        else if (arg.compare(0, 9, "--report=") == 0) report_path = arg.substr(9);
+        else if (arg.compare(0, 8, "--trace=") == 0) trace_path = arg.substr(8);
+        else add_instance_files(arg, files);
+    }
+    if (!trace_path.empty()) tracer.start();
+
+    if (batch) {
+        if (time_limit != NO_TIME_LIMIT) cerr << "Časový limit není v dávkovém režimu podporován" << endl;
+        if (!checkpoint_dir.empty()) cerr << "Checkpoint není v dávkovém režimu podporován" << endl;
+        solve_batch(files, report_path);
+        if (!trace_path.empty()) Tracer::write(trace_path, tracer.events(0, "openmp-data"));
+        return 0;
+    }
+
+    for (const auto &filename : files) {
+        string checkpoint_path = checkpoint_dir.empty() ? "" :
+                                 checkpoint_dir + "/" + filename.substr(filename.find_last_of('/') + 1) + ".checkpoint";
         long best = numeric_limits<long>::max();
+        auto load_start = chrono::high_resolution_clock::now();
         ChessBoard bestBoard = ChessBoard(filename);
-        long counter = 0;
+        auto load_stop = chrono::high_resolution_clock::now();
+        string hash = bestBoard.hash();
+        SearchStats stats;
+        double frontier_ms = 0;
 
         cout << bestBoard << endl;
         auto start = chrono::high_resolution_clock::now();
-        bb_dfs_data_par(new ChessBoard(filename), best, &bestBoard, counter);
+        Deadline deadline(time_limit);
+        bb_dfs_data_par(ChessBoard(filename), best, &bestBoard, stats, deadline, checkpoint_path,
+                        checkpoint_period, frontier_ms);
+        deadline.finish();
         auto stop = chrono::high_resolution_clock::now();
 
+        deadline.report(best);
+
         cout << "Cena\tPočet volání\tČas [ms]" << endl;
-        cout << best << "\t" << counter << "\t\t"
+        cout << best << "\t" << stats.nodes << "\t\t"
              << std::chrono::duration_cast<std::chrono::milliseconds>(stop - start).count() << endl << endl;
 
         cout << "Tahy" << endl;
         for (const auto &move : bestBoard.getMoveLog()) {
             cout << move << endl;
         }
+        stats.printProfile(cout);
 
+        if (!report_path.empty()) {
+            append_report(report_path, filename, hash, best, bestBoard, stats,
+                          chrono::duration<double, milli>(load_stop - load_start).count(), frontier_ms,
+                          chrono::duration<double, milli>(stop - start).count() - frontier_ms);
+        }
     }
+    if (!trace_path.empty()) Tracer::write(trace_path, tracer.events(0, "openmp-data"));
     return 0;
 }
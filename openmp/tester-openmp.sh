@@ -1,7 +1,11 @@
+# submits to the SGE queue, for local runs with repeated measurements see tools/sweep.py
 CPP_PROGRAM_TEMPLATE='main.template.cpp'
 RUN_SCRIPT_TEMPLATE='../serial_job.template.sh'
 CPP_COMPILE="g++"
-CPP_FLAGS="--std=c++11 -O3 -funroll-loops -fopenmp"
+CPP_FLAGS="--std=c++11 -O3 -funroll-loops -fopenmp" # -DPROFILE_TREE prints per-depth profile of the search tree,
+# -DPERF_COUNTERS adds hardware counters of each phase and thread to --report (perf_event_open, Linux)
+# -DMAILBOX_BOARD stores boards with a border of sentinel squares, the kernels read it without bounds checks
+# -DMAX_ROW_LEN=N, -DMAX_DEPTH=N raise the largest board side and max depth boards hold (16 and 64 by default)
 QRUN_CMD="qrun2 20c 1 pdp_serial"
 DATA_PATH="/home/saframa6/ni-pdp-semestralka/data"
 
@@ -44,7 +48,7 @@ do
 
 		sed "
 			s|{EXE_PROGRAM}|$EXE_PROGRAM|g;
-			s|{ARGUMENTS}|$DATA_PATH/saj$INSTANCE.txt|g;
+			s|{ARGUMENTS}|--report=${WORKDIR}/report.json $DATA_PATH/saj$INSTANCE.txt|g;
 			s|{STDOUT}|$STDOUT|g;
 			s|{STDERR}|$STDERR|g;
 			" ${RUN_SCRIPT_TEMPLATE} > ${RUN_SCRIPT}
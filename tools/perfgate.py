@@ -0,0 +1,170 @@
+#!/usr/bin/env python3
+"""Performance regression gate, compares a benchmark run with a stored baseline.
+
+usage: perfgate.py record BASELINE [sweep options...]
+       perfgate.py check BASELINE [--tolerance T] [sweep options...]
+       perfgate.py import BASELINE [--threshold T] out_directory...
+
+record runs tools/sweep.py with the given options and stores the summary of each configuration as BASELINE.
+check runs the same sweep and compares it with BASELINE configuration by configuration (engine, instance,
+threads, ranks). Throughput in searched nodes per second must not drop and search and wall time must not grow
+by more than T (default 0.1 = 10 %), otherwise the gate fails with exit code 1. Nodes per second normalise
+the time by the size of the searched tree, which changes between runs of parallel branch and bound.
+
+import builds BASELINE from stdout of the tester scripts (openmp/*/out*/*/stdout, mpi/out*/*/stdout):
+OpenMP outputs give nodes and search time, MPI outputs only the elapsed time of master as wall time.
+Only metrics present in both the baseline and the run are compared, and times are comparable only when
+measured on the same machine, which is checked against the hostname stored in the baseline.
+"""
+import argparse
+import csv
+import json
+import os
+import platform
+import re
+import subprocess
+import sys
+import tempfile
+
+TOOLS = os.path.dirname(os.path.realpath(__file__))
+
+# metric of summary.csv: True if higher is better
+METRICS = {
+    'nodes_per_s': True,
+    'search_ms_median': False,
+    'wall_ms_median': False,
+}
+
+# engine by the directory of its template
+LEGACY_ENGINES = {
+    'task-par': 'openmp-task',
+    'task-par-threshold': 'openmp-task-threshold',
+    'data-par': 'openmp-data',
+    'mpi': 'mpi-flat',
+}
+
+
+def key(config):
+    return '%s %s p%s n%s' % (config['engine'], os.path.basename(config['instance']), config['threads'],
+                              config['ranks'])
+
+
+def run_sweep(sweep_args):
+    """Summary of each configuration of the sweep, metrics as floats."""
+    with tempfile.TemporaryDirectory() as tmp:
+        command = [sys.executable, os.path.join(TOOLS, 'sweep.py')] + sweep_args + ['--output', tmp]
+        if subprocess.run(command).returncode != 0:
+            sys.exit('sweep selhal')
+        with open(os.path.join(tmp, 'summary.csv')) as f:
+            rows = list(csv.DictReader(f))
+    for row in rows:
+        for metric in METRICS:
+            row[metric] = float(row[metric])
+    return rows
+
+
+def revision():
+    result = subprocess.run(['git', '-C', TOOLS, 'describe', '--always', '--dirty'], stdout=subprocess.PIPE,
+                            universal_newlines=True)
+    return result.stdout.strip()
+
+
+def save(path, configs, sweep_args, host, label):
+    baseline = {'label': label, 'host': host, 'sweep': sweep_args,
+                'configs': {key(c): {m: c[m] for m in METRICS if c.get(m) is not None} for c in configs}}
+    os.makedirs(os.path.dirname(path) or '.', exist_ok=True)
+    with open(path, 'w') as f:
+        json.dump(baseline, f, indent=1, ensure_ascii=False)
+        f.write('\n')
+    print('Baseline %s: %d konfigurací (%s)' % (path, len(configs), baseline['label']))
+
+
+def parse_legacy(stdout_path):
+    """Metrics of one run of the tester scripts, empty if the run has not finished."""
+    with open(stdout_path, errors='replace') as f:
+        text = f.read()
+    result = re.search(r'Cena\tPočet volání\tČas \[ms\]\n-?\d+\t(\d+)\t+(\d+)', text)
+    if result:
+        nodes, search_ms = int(result.group(1)), float(result.group(2))
+        return {'nodes_per_s': round(1000 * nodes / search_ms) if search_ms > 0 else 0, 'search_ms_median': search_ms}
+    elapsed = re.search(r'^0: Elapsed time is ([\d.]+)\.', text, re.MULTILINE)
+    if elapsed:
+        return {'wall_ms_median': 1000 * float(elapsed.group(1))}
+    return {}
+
+
+def import_legacy(directories, threshold):
+    configs = []
+    for directory in directories:
+        for name in sorted(os.listdir(directory)):
+            match = re.match(r'saj(\d+)(?:-n(\d+))?-p(\d+)(?:-t(\d+))?$', name)
+            stdout_path = os.path.join(directory, name, 'stdout')
+            if not match or not os.path.exists(stdout_path):
+                continue
+            if match.group(4) is not None and int(match.group(4)) != threshold:
+                continue
+            template_dir = os.path.basename(os.path.dirname(os.path.realpath(directory)))
+            if template_dir not in LEGACY_ENGINES:
+                sys.exit('%s: neznámý engine %s' % (directory, template_dir))
+            metrics = parse_legacy(stdout_path)
+            if metrics:
+                configs.append(dict(metrics, engine=LEGACY_ENGINES[template_dir],
+                                    instance='saj%s.txt' % match.group(1), threads=match.group(3),
+                                    ranks=match.group(2) or 1))
+    return configs
+
+
+def compare(baseline, configs, tolerance):
+    """Prints comparison of each configuration, returns number of regressions."""
+    if baseline.get('host') != platform.node():
+        print('Varování: baseline byla změřena na %s, časy nejsou přímo srovnatelné' % baseline.get('host'))
+    regressions = 0
+    print('Konfigurace\tMetrika\tBaseline\tBěh\tZměna')
+    for config in configs:
+        base = baseline['configs'].get(key(config))
+        if base is None:
+            print('%s\tchybí v baseline' % key(config))
+            continue
+        for metric, higher_better in METRICS.items():
+            if metric not in base or base[metric] <= 0:
+                continue
+            change = config[metric] / base[metric] - 1
+            regressed = -change > tolerance if higher_better else change > tolerance
+            regressions += regressed
+            print('%s\t%s\t%.1f\t%.1f\t%+.1f %%%s' % (key(config), metric, base[metric], config[metric],
+                                                    100 * change, '\tREGRESE' if regressed else ''))
+    return regressions
+
+
+def main():
+    if len(sys.argv) < 3 or sys.argv[1] not in ('record', 'check', 'import'):
+        sys.exit(__doc__)
+    command, path, rest = sys.argv[1], sys.argv[2], sys.argv[3:]
+
+    if command == 'import':
+        parser = argparse.ArgumentParser(usage=__doc__)
+        parser.add_argument('--threshold', type=int, default=4)
+        parser.add_argument('directories', nargs='+')
+        args = parser.parse_args(rest)
+        save(path, import_legacy(args.directories, args.threshold), [], 'fronta SGE', ' '.join(args.directories))
+        return 0
+
+    if command == 'record':
+        save(path, run_sweep(rest), rest, platform.node(), revision())
+        return 0
+
+    parser = argparse.ArgumentParser(usage=__doc__)
+    parser.add_argument('--tolerance', type=float, default=0.1)
+    args, sweep_args = parser.parse_known_args(rest)
+    with open(path) as f:
+        baseline = json.load(f)
+    regressions = compare(baseline, run_sweep(sweep_args or baseline['sweep']), args.tolerance)
+    if regressions:
+        print('Výkon se zhoršil v %d metrikách o více než %.0f %%' % (regressions, 100 * args.tolerance))
+        return 1
+    print('Bez regrese (tolerance %.0f %%)' % (100 * args.tolerance))
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,68 @@
+#!/usr/bin/env python3
+"""Converts SAJ instances from the text format to one binary pack (.sajb) loaded by the engines via mmap.
+
+usage: saj2bin.py output.sajb instance_file_or_directory...
+
+Pack layout (little-endian), see class InstancePack in the engines:
+  header  "SAJB", version, instance count, reserved (uint32 each), record offsets (uint64 * count)
+  record  rowLen, maxDepth, horse square, bishop square (uint32 each), pawn bitset (uint64 * ceil(rowLen^2 / 64))
+Instance i of the pack is addressed as "output.sajb#i", in the order the inputs were given
+(files of a directory sorted by name).
+"""
+import os
+import struct
+import sys
+
+MAGIC = b'SAJB'
+VERSION = 1
+
+
+def read_instance(path):
+    with open(path) as f:
+        tokens = f.readline().split()
+        row_len = int(tokens[0])
+        max_depth = int(tokens[1]) if len(tokens) > 1 else int(f.readline())
+        grid = ''.join(c for c in f.read() if c not in '\r\n')[:row_len * row_len]
+    if len(grid) != row_len * row_len:
+        raise ValueError('%s: šachovnice má %d polí místo %d' % (path, len(grid), row_len * row_len))
+    pawns = [0] * ((len(grid) + 63) // 64)
+    for square, c in enumerate(grid):
+        if c == 'P':
+            pawns[square // 64] |= 1 << (square % 64)
+    return row_len, max_depth, grid.index('J'), grid.index('S'), pawns
+
+
+def pack_record(instance):
+    row_len, max_depth, horse, bishop, pawns = instance
+    return struct.pack('<4I', row_len, max_depth, horse, bishop) + struct.pack('<%dQ' % len(pawns), *pawns)
+
+
+def instance_files(paths):
+    for path in paths:
+        if os.path.isdir(path):
+            for name in sorted(os.listdir(path)):
+                if name.endswith('.txt'):
+                    yield os.path.join(path, name)
+        else:
+            yield path
+
+
+def main(argv):
+    if len(argv) < 3:
+        sys.exit(__doc__)
+    records = [pack_record(read_instance(path)) for path in instance_files(argv[2:])]
+    offset = 16 + 8 * len(records)
+    offsets = []
+    for record in records:
+        offsets.append(offset)
+        offset += len(record)
+    with open(argv[1], 'wb') as out:
+        out.write(MAGIC + struct.pack('<3I', VERSION, len(records), 0))
+        out.write(struct.pack('<%dQ' % len(offsets), *offsets))
+        for record in records:
+            out.write(record)
+    print('%s: %d instancí' % (argv[1], len(records)))
+
+
+if __name__ == '__main__':
+    main(sys.argv)
@@ -0,0 +1,174 @@
+#!/usr/bin/env python3
+"""Deterministic generator of SAJ instances (bishop S, knight J, pawns P) for scaling experiments.
+
+usage: sajgen.py [--size N] [--pawns K | --density D] [--difficulty easy|medium|hard] [--spread R]
+                 [--slack M] [--seed S] [--count C] [--output DIR]
+
+Pawns and both pieces are placed uniformly at random into a window of squares at most R rows and columns
+from a random center, by a seeded generator, so the same arguments give the same instances on any machine.
+maxDepth is the length of a solution found by beam search (bishop moves first) plus slack, so every
+instance has a solution within maxDepth. Wider spread and slack loosen the initial upper bound of branch
+and bound and make the search harder, difficulty presets set them together with pawn density when they
+are not given explicitly:
+    easy    density 0.04, spread 2, slack 0
+    medium  density 0.06, spread 3, slack K / 4
+    hard    density 0.08, spread N / 2, slack K / 2
+Without --output the instance is printed to stdout, otherwise C files DIR/gen_N_K_S_i.txt are written.
+"""
+import argparse
+import os
+import random
+import sys
+from collections import deque
+
+HORSE = 'J'
+BISHOP = 'S'
+PAWN = 'P'
+EMPTY = '-'
+
+HORSE_CAND = [(-2, -1), (-2, 1), (-1, -2), (-1, 2), (1, -2), (1, 2), (2, -1), (2, 1)]
+BISHOP_DIRS = [(-1, 1), (-1, -1), (1, 1), (1, -1)]
+BEAM_WIDTH = 32
+
+# density, spread, slack
+DIFFICULTY = {
+    'easy': (0.04, lambda n: 2, lambda pawns: 0),
+    'medium': (0.06, lambda n: 3, lambda pawns: pawns // 4),
+    'hard': (0.08, lambda n: n // 2, lambda pawns: pawns // 2),
+}
+
+
+def moves(grid, n, square, piece):
+    """Squares the piece on square can move to, same rules as NextPossibleMoves in the engines."""
+    row, col = divmod(square, n)
+    result = []
+    if piece == HORSE:
+        for dr, dc in HORSE_CAND:
+            r, c = row + dr, col + dc
+            if 0 <= r < n and 0 <= c < n and grid[r * n + c] in (EMPTY, PAWN):
+                result.append(r * n + c)
+    else:
+        for dr, dc in BISHOP_DIRS:
+            r, c = row + dr, col + dc
+            while 0 <= r < n and 0 <= c < n and grid[r * n + c] in (EMPTY, PAWN):
+                result.append(r * n + c)
+                if grid[r * n + c] == PAWN:
+                    break
+                r, c = r + dr, c + dc
+    return result
+
+
+def distance_to_pawn(grid, n, square, piece):
+    """Number of moves of the piece to the nearest pawn, unreachable pawns count as n * n moves."""
+    dist = {square: 0}
+    queue = deque([square])
+    while queue:
+        at = queue.popleft()
+        for to in moves(grid, n, at, piece):
+            if to in dist:
+                continue
+            dist[to] = dist[at] + 1
+            if grid[to] == PAWN:
+                return dist[to]
+            queue.append(to)
+    return n * n
+
+
+def beam_solution(grid, n):
+    """Number of moves of a solution found by beam search, None if none was found.
+
+    Positions after each move are ranked by remaining pawns and distances of both pieces to their nearest
+    pawn, only BEAM_WIDTH best of them are expanded further.
+    """
+    positions = [tuple(grid)]
+    piece = BISHOP
+    for depth in range(1, 4 * n * n + 1):
+        ranked = {}
+        for position in positions:
+            square = position.index(piece)
+            for to in moves(position, n, square, piece):
+                nxt = list(position)
+                nxt[square] = EMPTY
+                nxt[to] = piece
+                nxt = tuple(nxt)
+                if nxt in ranked:
+                    continue
+                pawns = nxt.count(PAWN)
+                if pawns == 0:
+                    return depth
+                ranked[nxt] = (pawns * 4 * n * n + distance_to_pawn(nxt, n, nxt.index(BISHOP), BISHOP)
+                               + distance_to_pawn(nxt, n, nxt.index(HORSE), HORSE))
+        if not ranked:
+            return None
+        positions = sorted(ranked, key=lambda p: (ranked[p], p))[:BEAM_WIDTH]
+        piece = HORSE if piece == BISHOP else BISHOP
+    return None
+
+
+def window(n, center, spread):
+    row, col = divmod(center, n)
+    return [r * n + c
+            for r in range(max(0, row - spread), min(n, row + spread + 1))
+            for c in range(max(0, col - spread), min(n, col + spread + 1))]
+
+
+def generate(n, pawns, spread, slack, rng):
+    while True:
+        squares = window(n, rng.randrange(n * n), spread)
+        if len(squares) < pawns + 2:
+            continue
+        squares = rng.sample(squares, pawns + 2)
+        grid = [EMPTY] * (n * n)
+        grid[squares[0]] = BISHOP
+        grid[squares[1]] = HORSE
+        for square in squares[2:]:
+            grid[square] = PAWN
+        length = beam_solution(grid, n)
+        if length is not None:
+            return grid, length + slack
+
+
+def format_instance(grid, n, max_depth):
+    rows = [''.join(grid[r * n:(r + 1) * n]) for r in range(n)]
+    return '%d %d\n%s\n' % (n, max_depth, '\n'.join(rows))
+
+
+def main():
+    parser = argparse.ArgumentParser(usage=__doc__)
+    parser.add_argument('--size', type=int, default=11)
+    parser.add_argument('--pawns', type=int)
+    parser.add_argument('--density', type=float)
+    parser.add_argument('--difficulty', choices=sorted(DIFFICULTY), default='medium')
+    parser.add_argument('--spread', type=int)
+    parser.add_argument('--slack', type=int)
+    parser.add_argument('--seed', type=int, default=0)
+    parser.add_argument('--count', type=int, default=1)
+    parser.add_argument('--output')
+    args = parser.parse_args()
+
+    density, spread_of, slack_of = DIFFICULTY[args.difficulty]
+    if args.density is not None:
+        density = args.density
+    pawns = args.pawns if args.pawns is not None else max(1, round(density * args.size * args.size))
+    if args.size < 3 or pawns + 2 > args.size * args.size:
+        sys.exit('nelze umístit %d pěšců na šachovnici %dx%d' % (pawns, args.size, args.size))
+    spread = args.spread if args.spread is not None else spread_of(args.size)
+    if min(2 * spread + 1, args.size) ** 2 < pawns + 2:
+        sys.exit('nelze umístit %d pěšců do okna se vzdáleností %d' % (pawns, spread))
+    slack = args.slack if args.slack is not None else slack_of(pawns)
+
+    rng = random.Random('%d/%d/%d/%d/%d' % (args.seed, args.size, pawns, spread, slack))
+    for i in range(args.count):
+        grid, max_depth = generate(args.size, pawns, spread, slack, rng)
+        text = format_instance(grid, args.size, max_depth)
+        if args.output is None:
+            sys.stdout.write(text)
+            continue
+        os.makedirs(args.output, exist_ok=True)
+        name = os.path.join(args.output, 'gen_%d_%d_%d_%d.txt' % (args.size, pawns, args.seed, i))
+        with open(name, 'w') as f:
+            f.write(text)
+
+
+if __name__ == '__main__':
+    main()
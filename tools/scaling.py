@@ -0,0 +1,223 @@
+#!/usr/bin/env python3
+"""Speedup and efficiency analysis of run reports across thread and rank counts.
+
+usage: scaling.py [--metric search_ms|wall_ms] [--reference ENGINE] [--tolerance T] [--output DIR] report...
+
+Report is a file of JSON lines written by --report of the engines or DIR/runs.json of tools/sweep.py, directory
+stands for all report.json and runs.json files under it. Warm-up runs of the sweep are skipped, repeated runs
+of one configuration (engine, instance, threads, ranks) are reduced to the median time and node count.
+Workers of a configuration are threads * ranks.
+
+Speedup of each configuration is relative to the run with the fewest workers of the same engine and instance,
+or to the 1-worker run of the reference engine (e.g. openmp-task compiled for one thread as the sequential
+algorithm). A baseline with more than one worker is assumed to scale perfectly up to its worker count.
+Efficiency is speedup / workers and Karp-Flatt serial fraction is (1/S - 1/p) / (1 - 1/p).
+
+Branch and bound searches a different tree on each run: an incumbent found early by one of the workers prunes
+the tree for all of them, so speedup above the worker count is common and says nothing about the parallel
+efficiency. Work speedup normalises the time by searched nodes (ratio of nodes per second), a run that is
+superlinear only in time is reported as a search anomaly, superlinear work speedup (more than T above the
+worker count, default 0.05) as true superlinear speedup, e.g. from caches.
+
+Amdahl's law S = 1 / (f + (1 - f) / p) and Gustafson's law S = p - a (p - 1) are fitted per engine and instance
+by least squares, both to the speedup and to the work speedup. Gustafson's law assumes the problem grows with p,
+for a fixed instance its serial fraction only describes the slope of the measured speedup.
+"""
+import argparse
+import csv
+import json
+import math
+import os
+import statistics
+import sys
+
+
+def report_files(paths):
+    for path in paths:
+        if not os.path.isdir(path):
+            yield path
+            continue
+        for root, _, names in sorted(os.walk(path)):
+            for name in sorted(names):
+                if name in ('report.json', 'runs.json'):
+                    yield os.path.join(root, name)
+
+
+def load(paths, metric):
+    """Measured times and node counts of each configuration."""
+    runs = {}
+    for path in report_files(paths):
+        with open(path) as f:
+            for line in f:
+                if not line.strip():
+                    continue
+                report = json.loads(line)
+                if report.get('warmup') or report.get('benchmark') or metric not in report:
+                    continue
+                config = (report['engine'], os.path.basename(report['instance']), int(report['threads']),
+                          int(report['ranks']))
+                runs.setdefault(config, []).append((float(report[metric]), report.get('nodes')))
+    return runs
+
+
+def summarize(runs):
+    """Rows of configurations with median time and node count, ordered by engine, instance and workers."""
+    rows = []
+    for (engine, instance, threads, ranks), measured in runs.items():
+        nodes = [n for _, n in measured if n is not None]
+        rows.append(dict(engine=engine, instance=instance, threads=threads, ranks=ranks, workers=threads * ranks,
+                         runs=len(measured), time_ms=statistics.median(t for t, _ in measured),
+                         nodes=statistics.median(nodes) if nodes else None))
+    rows.sort(key=lambda r: (r['engine'], r['instance'], r['workers'], r['ranks']))
+    return rows
+
+
+def karp_flatt(speedup, workers):
+    if workers <= 1 or speedup <= 0:
+        return None
+    return (1 / speedup - 1 / workers) / (1 - 1 / workers)
+
+
+def baseline_for(row, rows, reference):
+    """Configuration the speedup of row is relative to, None if there is none."""
+    if reference:
+        candidates = [r for r in rows if r['engine'] == reference and r['instance'] == row['instance']
+                      and r['workers'] == 1]
+    else:
+        candidates = [r for r in rows if r['engine'] == row['engine'] and r['instance'] == row['instance']]
+    return min(candidates, key=lambda r: r['workers']) if candidates else None
+
+
+def analyze(rows, reference, tolerance):
+    for row in rows:
+        base = baseline_for(row, rows, reference)
+        if base is None or row['time_ms'] <= 0:
+            continue
+        p = row['workers']
+        row['baseline'] = '%s p%d n%d' % (base['engine'], base['threads'], base['ranks'])
+        row['speedup'] = base['workers'] * base['time_ms'] / row['time_ms']
+        row['efficiency'] = row['speedup'] / p
+        row['karp_flatt'] = karp_flatt(row['speedup'], p)
+        if base['nodes'] and row['nodes']:
+            row['work_speedup'] = row['speedup'] * row['nodes'] / base['nodes']
+            row['work_efficiency'] = row['work_speedup'] / p
+            row['work_karp_flatt'] = karp_flatt(row['work_speedup'], p)
+        note = ''
+        if row['speedup'] > p * (1 + tolerance):
+            if row.get('work_speedup') is None:
+                note = 'superlineární (bez počtu uzlů)'
+            elif row['work_speedup'] > p * (1 + tolerance):
+                note = 'superlineární'
+            else:
+                note = 'anomálie prohledávání'
+        row['note'] = note
+
+
+def fit_amdahl(points):
+    """Serial fraction f minimising squared error of 1 / S, which is linear in f: 1/S - 1/p = f (1 - 1/p)."""
+    xs = [1 - 1 / p for p, _ in points]
+    ys = [1 / s - 1 / p for p, s in points]
+    denominator = sum(x * x for x in xs)
+    if denominator == 0:
+        return None
+    return min(1.0, max(0.0, sum(x * y for x, y in zip(xs, ys)) / denominator))
+
+
+def fit_gustafson(points):
+    """Serial fraction a minimising squared error of S, which is linear in a: p - S = a (p - 1)."""
+    denominator = sum((p - 1) ** 2 for p, _ in points)
+    if denominator == 0:
+        return None
+    return sum((p - 1) * (p - s) for p, s in points) / denominator
+
+
+def rmse(points, model):
+    return math.sqrt(sum((model(p) - s) ** 2 for p, s in points) / len(points))
+
+
+def fits(rows):
+    """Amdahl and Gustafson fits of each engine and instance, for speedup and for work speedup."""
+    groups = {}
+    for row in rows:
+        groups.setdefault((row['engine'], row['instance']), []).append(row)
+    result = []
+    for (engine, instance), group in sorted(groups.items()):
+        for basis, field in (('čas', 'speedup'), ('práce', 'work_speedup')):
+            points = [(r['workers'], r[field]) for r in group if r.get(field)]
+            if len({p for p, _ in points}) < 2:
+                continue
+            f = fit_amdahl(points)
+            a = fit_gustafson(points)
+            if f is None or a is None:
+                continue
+            result.append(dict(engine=engine, instance=instance, basis=basis, points=len(points),
+                               amdahl_serial_fraction=f, amdahl_max_speedup=1 / f if f > 0 else math.inf,
+                               amdahl_rmse=rmse(points, lambda p: 1 / (f + (1 - f) / p)),
+                               gustafson_serial_fraction=a, gustafson_rmse=rmse(points, lambda p: p - a * (p - 1))))
+    return result
+
+
+def formatted(value, digits=3):
+    if value is None:
+        return ''
+    if isinstance(value, float):
+        return ('%.' + str(digits) + 'f') % value
+    return str(value)
+
+
+SCALING_FIELDS = ['engine', 'instance', 'threads', 'ranks', 'workers', 'runs', 'time_ms', 'nodes', 'baseline',
+                  'speedup', 'efficiency', 'karp_flatt', 'work_speedup', 'work_efficiency', 'work_karp_flatt', 'note']
+FIT_FIELDS = ['engine', 'instance', 'basis', 'points', 'amdahl_serial_fraction', 'amdahl_max_speedup', 'amdahl_rmse',
+              'gustafson_serial_fraction', 'gustafson_rmse']
+
+
+def write_csv(path, fields, rows):
+    with open(path, 'w', newline='') as f:
+        writer = csv.DictWriter(f, fieldnames=fields, extrasaction='ignore')
+        writer.writeheader()
+        writer.writerows({k: formatted(row.get(k), 6) for k in fields} for row in rows)
+
+
+def main():
+    parser = argparse.ArgumentParser(usage=__doc__)
+    parser.add_argument('--metric', choices=['search_ms', 'wall_ms'], default='search_ms')
+    parser.add_argument('--reference')
+    parser.add_argument('--tolerance', type=float, default=0.05)
+    parser.add_argument('--output')
+    parser.add_argument('reports', nargs='+')
+    args = parser.parse_args()
+
+    rows = summarize(load(args.reports, args.metric))
+    if not rows:
+        sys.exit('žádné reporty s %s' % args.metric)
+    analyze(rows, args.reference, args.tolerance)
+    fitted = fits(rows)
+
+    print('Engine\tInstance\tp\tn\tČas [ms]\tUzly\tZrychlení\tEfektivita\tKarp-Flatt\tZrychl. práce\tEfekt. práce'
+          '\tPoznámka')
+    for r in rows:
+        print('\t'.join([r['engine'], r['instance'], str(r['threads']), str(r['ranks']), formatted(r['time_ms'], 1),
+                         formatted(r['nodes'], 0)] +
+                        [formatted(r.get(k)) for k in ('speedup', 'efficiency', 'karp_flatt', 'work_speedup',
+                                                       'work_efficiency')] + [r.get('note', '')]))
+    if fitted:
+        print()
+        print('Engine\tInstance\tZáklad\tBodů\tAmdahl f\tAmdahl max\tAmdahl RMSE\tGustafson a\tGustafson RMSE')
+        for fit in fitted:
+            print('\t'.join([fit['engine'], fit['instance'], fit['basis'], str(fit['points'])] +
+                            [formatted(fit[k]) for k in FIT_FIELDS[4:]]))
+    anomalies = [r for r in rows if r.get('note') == 'anomálie prohledávání']
+    if anomalies:
+        print()
+        print('Anomálií prohledávání: %d, jejich zrychlení je dané menším prohledaným stromem' % len(anomalies))
+
+    if args.output:
+        os.makedirs(args.output, exist_ok=True)
+        write_csv(os.path.join(args.output, 'scaling.csv'), SCALING_FIELDS, rows)
+        write_csv(os.path.join(args.output, 'fits.csv'), FIT_FIELDS, fitted)
+        print('Výsledky: %s, %s' % (os.path.join(args.output, 'scaling.csv'), os.path.join(args.output, 'fits.csv')))
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
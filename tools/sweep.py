@@ -0,0 +1,216 @@
+#!/usr/bin/env python3
+"""Local experiment runner, runs grids of engine x instance x threads x ranks without the SGE queue.
+
+usage: sweep.py [--engines E,...] [--instances I,...] [--threads P,...] [--ranks N,...] [--threshold T]
+                [--warmup W] [--repeats R] [--noise CV] [--timeout S] [--mpirun CMD] [--data DIR] [--output DIR]
+
+Engines are compiled from their templates once per thread count (the {PROCNUM} placeholder), like the tester
+scripts do, into DIR/build. Every configuration is run W times to warm up caches and page cache of the
+instance, then R times measured. Reports of all runs (see --report of the engines) are appended to DIR/runs.json
+with fields of the sweep added: configuration, repeat, warmup and wall_ms measured around the whole process.
+
+Summary of each configuration (DIR/summary.csv and stdout) holds median, mean and 95% confidence interval of the
+mean of search time and wall time, median node count and nodes per second. Configuration whose search time has
+coefficient of variation above CV is marked noisy; runs of one instance finding different costs are reported
+as an error, branch and bound must find the same optimum regardless of the configuration.
+
+Instance is a saj instance id (7 -> DATA/saj7.txt, as in the tester scripts) or a path.
+Ranks apply only to MPI engines, thread counts and threshold are substituted into the templates.
+Speedup, efficiency and scaling models of the runs are computed by tools/scaling.py DIR/runs.json.
+"""
+import argparse
+import csv
+import json
+import math
+import os
+import shlex
+import statistics
+import subprocess
+import sys
+import tempfile
+import time
+
+REPO = os.path.dirname(os.path.dirname(os.path.realpath(__file__)))
+CPP_FLAGS = ['--std=c++11', '-O3', '-funroll-loops', '-fopenmp']
+
+# name as in the reports: template, compiler, is MPI, extra arguments
+ENGINES = {
+    'openmp-task': ('openmp/task-par/main.template.cpp', 'g++', False, []),
+    'openmp-task-threshold': ('openmp/task-par-threshold/main.template.cpp', 'g++', False, []),
+    'openmp-data': ('openmp/data-par/main.template.cpp', 'g++', False, []),
+    'mpi-flat': ('mpi/main.template.cpp', 'mpicxx', True, ['--topology=flat']),
+    'mpi-hier': ('mpi/main.template.cpp', 'mpicxx', True, ['--topology=hier']),
+    'mpi-hda': ('mpi/hda/main.template.cpp', 'mpicxx', True, []),
+}
+
+# two-sided 97.5% quantiles of Student's t distribution by degrees of freedom, normal quantile above
+T_975 = [12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+         2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+         2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042]
+
+
+def t_quantile(df):
+    return T_975[df - 1] if df <= len(T_975) else 1.960
+
+
+def describe(values):
+    """Median, mean and half-width of 95% confidence interval of the mean (0 for a single value)."""
+    mean = statistics.mean(values)
+    half = 0.0
+    if len(values) > 1:
+        half = t_quantile(len(values) - 1) * statistics.stdev(values) / math.sqrt(len(values))
+    return statistics.median(values), mean, half
+
+
+def variation(values):
+    mean = statistics.mean(values)
+    return statistics.stdev(values) / mean if len(values) > 1 and mean > 0 else 0.0
+
+
+def split(text, convert=str):
+    return [convert(item) for item in text.split(',') if item]
+
+
+def instance_path(instance, data):
+    if os.path.exists(instance) or '/' in instance:
+        return instance
+    return os.path.join(data, 'saj%s.txt' % instance)
+
+
+def build(engine, threads, threshold, build_dir):
+    """Compiled engine for the thread count, reused by every run and by engines sharing the template."""
+    template, compiler, _, _ = ENGINES[engine]
+    name = '%s-p%d-t%d' % (template.replace('/', '_').replace('.template.cpp', ''), threads, threshold)
+    exe = os.path.join(build_dir, name + '.out')
+    if os.path.exists(exe):
+        return exe
+    with open(os.path.join(REPO, template)) as f:
+        source = f.read().replace('{PROCNUM}', str(threads)).replace('{THRESHOLD}', str(threshold))
+    cpp = os.path.join(build_dir, name + '.cpp')
+    with open(cpp, 'w') as f:
+        f.write(source)
+    command = [compiler] + CPP_FLAGS + [cpp, '-o', exe]
+    print('COMPILE: %s' % ' '.join(command), flush=True)
+    subprocess.run(command, check=True)
+    return exe
+
+
+def run_once(command, timeout):
+    """Report of one run with wall_ms added, None if the run failed."""
+    with tempfile.TemporaryDirectory() as tmp:
+        report_path = os.path.join(tmp, 'report.json')
+        start = time.perf_counter()
+        try:
+            result = subprocess.run(command + ['--report=' + report_path], stdout=subprocess.DEVNULL,
+                                    stderr=subprocess.PIPE, timeout=timeout)
+        except subprocess.TimeoutExpired:
+            print('\tčasový limit %s s vypršel' % timeout, file=sys.stderr)
+            return None
+        wall_ms = 1000 * (time.perf_counter() - start)
+        if result.returncode != 0 or not os.path.exists(report_path):
+            print('\tběh selhal (%d): %s' % (result.returncode, result.stderr.decode(errors='replace').strip()),
+                  file=sys.stderr)
+            return None
+        with open(report_path) as f:
+            report = json.loads(f.readline())
+    report['wall_ms'] = round(wall_ms, 3)
+    return report
+
+
+def summarize(config, reports, noise):
+    search = [r['search_ms'] for r in reports]
+    wall = [r['wall_ms'] for r in reports]
+    nodes = [r['nodes'] for r in reports]
+    search_median, search_mean, search_ci = describe(search)
+    wall_median, wall_mean, wall_ci = describe(wall)
+    nodes_median = statistics.median(nodes)
+    cv = variation(search)
+    return dict(config, runs=len(reports), cost=reports[0]['cost'],
+                search_ms_median=round(search_median, 3), search_ms_mean=round(search_mean, 3),
+                search_ms_ci95=round(search_ci, 3), wall_ms_median=round(wall_median, 3),
+                wall_ms_mean=round(wall_mean, 3), wall_ms_ci95=round(wall_ci, 3), nodes_median=nodes_median,
+                nodes_per_s=round(1000 * nodes_median / search_median) if search_median > 0 else 0,
+                cv=round(cv, 4), noisy=cv > noise)
+
+
+def main():
+    parser = argparse.ArgumentParser(usage=__doc__)
+    parser.add_argument('--engines', default='openmp-task,openmp-data,mpi-flat')
+    parser.add_argument('--instances', default='7')
+    parser.add_argument('--threads', default='1,2,4')
+    parser.add_argument('--ranks', default='2,3')
+    parser.add_argument('--threshold', type=int, default=4)
+    parser.add_argument('--warmup', type=int, default=1)
+    parser.add_argument('--repeats', type=int, default=5)
+    parser.add_argument('--noise', type=float, default=0.05)
+    parser.add_argument('--timeout', type=float)
+    parser.add_argument('--mpirun', default='mpirun')
+    parser.add_argument('--data', default=os.environ.get('DATA_PATH', '/home/saframa6/ni-pdp-semestralka/data'))
+    parser.add_argument('--output', default='sweep')
+    args = parser.parse_args()
+
+    engines = split(args.engines)
+    for engine in engines:
+        if engine not in ENGINES:
+            sys.exit('neznámý engine %s, známé jsou: %s' % (engine, ', '.join(ENGINES)))
+    if args.repeats < 1:
+        sys.exit('počet opakování musí být alespoň 1')
+    build_dir = os.path.join(args.output, 'build')
+    os.makedirs(build_dir, exist_ok=True)
+    runs_path = os.path.join(args.output, 'runs.json')
+
+    summaries = []
+    costs = {}
+    for instance in split(args.instances):
+        path = instance_path(instance, args.data)
+        for engine in engines:
+            _, _, is_mpi, engine_args = ENGINES[engine]
+            for threads in split(args.threads, int):
+                exe = build(engine, threads, args.threshold, build_dir)
+                for ranks in (split(args.ranks, int) if is_mpi else [1]):
+                    config = dict(engine=engine, instance=path, threads=threads, ranks=ranks)
+                    command = [exe] + engine_args + [path]
+                    if is_mpi:
+                        command = shlex.split(args.mpirun) + ['-np', str(ranks)] + command
+                    print('%s %s p%d n%d' % (engine, os.path.basename(path), threads, ranks), flush=True)
+
+                    reports = []
+                    for repeat in range(args.warmup + args.repeats):
+                        report = run_once(command, args.timeout)
+                        if report is None:
+                            continue
+                        warmup = repeat < args.warmup
+                        report.update(config, repeat=repeat, warmup=warmup)
+                        with open(runs_path, 'a') as f:
+                            f.write(json.dumps(report) + '\n')
+                        if not warmup:
+                            reports.append(report)
+                    if not reports:
+                        print('\tžádný úspěšný běh', file=sys.stderr)
+                        continue
+
+                    summary = summarize(config, reports, args.noise)
+                    summaries.append(summary)
+                    print('\tčas %.1f ms (± %.1f), %d uzlů, %d uzlů/s%s' % (
+                        summary['search_ms_median'], summary['search_ms_ci95'], summary['nodes_median'],
+                        summary['nodes_per_s'], ', HLUČNÉ (CV %.1f %%)' % (100 * summary['cv'])
+                        if summary['noisy'] else ''), flush=True)
+                    costs.setdefault(path, set()).update(r['cost'] for r in reports)
+
+    if summaries:
+        with open(os.path.join(args.output, 'summary.csv'), 'w', newline='') as f:
+            writer = csv.DictWriter(f, fieldnames=list(summaries[0]))
+            writer.writeheader()
+            writer.writerows(summaries)
+    noisy = [s for s in summaries if s['noisy']]
+    if noisy:
+        print('Hlučných konfigurací: %d z %d, zvyšte --repeats nebo uvolněte stroj' % (len(noisy), len(summaries)))
+    wrong = {path: sorted(found) for path, found in costs.items() if len(found) > 1}
+    for path, found in wrong.items():
+        print('CHYBA: %s má v různých bězích různé ceny %s' % (path, found), file=sys.stderr)
+    print('Výsledky: %s, %s' % (runs_path, os.path.join(args.output, 'summary.csv')))
+    return 1 if wrong else 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())